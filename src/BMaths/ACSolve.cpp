@@ -0,0 +1,225 @@
+#include "ACSolve.h"
+#include "threadPool.h"
+#include "sparseLU.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+std::vector<double> createLogFrequencies(double start, double stop, int points) {
+  std::vector<double> output;
+  if (points < 2) {
+    output.push_back(start);
+    return output;
+  }
+  double logStart = std::log10(start);
+  double logStop = std::log10(stop);
+  for (int i = 0; i < points; i++) {
+    output.push_back(std::pow(10.0, logStart + (logStop - logStart) * i / (points - 1)));
+  }
+  return output;
+}
+
+ACResult ACSweep(const matrix<double>& A, const matrix<double>& E, const matrix<complexNumber<double>>& F, const std::vector<double>& frequencies, int threads) {
+  int n = A.rows;
+  int points = frequencies.size();
+  ACResult result;
+  result.frequency = frequencies;
+  result.solution = std::vector<std::vector<complexNumber<double>>>(points);
+
+  // Only the entries of E are imaginary so they are the only ones that change
+  std::vector<std::pair<int, double>> EEntries;
+  for (int i = 0; i < n * n; i++) {
+    if (E.data[i] != 0.0) {
+      EEntries.push_back({i, E.data[i]});
+    }
+  }
+
+  auto solveRange = [&](int first, int last) {
+    matrix<complexNumber<double>> M = createMatrix<complexNumber<double>>(n, n);
+    denseLU<complexNumber<double>> MLU;
+    for (int i = first; i < last; i++) {
+      double w = 2 * M_PI * frequencies[i];
+      for (int j = 0; j < n * n; j++) {
+        M.data[j] = complexNumber<double>(A.data[j], 0.0);
+      }
+      for (auto& entry : EEntries) {
+        M.data[entry.first].b += w * entry.second;
+      }
+      MLU.factor(M);
+      std::vector<complexNumber<double>> x = F.data;
+      MLU.solveInPlace(x);
+      result.solution[i] = x;
+    }
+  };
+
+  threadPool pool(threads);
+  if (pool.size() <= 1 || points <= 1) {
+    solveRange(0, points);
+    return result;
+  }
+  // A few chunks per thread so the pool can even them out, each chunk
+  // reuses its matrix and LU storage
+  int chunks = std::min(points, 4 * pool.size());
+  parallelFor(pool, chunks, [&](int chunk) {
+    solveRange(chunk * points / chunks, (chunk + 1) * points / chunks);
+  });
+  return result;
+}
+
+matrix<double> linearizeDevices(const matrix<double>& A, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, const std::vector<double>& x) {
+  matrix<double> output = A;
+  for (auto& device : devices) {
+    auto entries = device->jacobianEntries();
+    std::vector<double> jacobian(entries.size());
+    device->smallSignal(x, jacobian);
+    for (int k = 0; k < (int)entries.size(); k++) {
+      output[entries[k].first][entries[k].second] += jacobian[k];
+    }
+  }
+  return output;
+}
+
+sparseMatrix<double> linearizeDevices(const sparseMatrix<double>& A, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, const std::vector<double>& x) {
+  sparseMatrix<double> output = A;
+  for (auto& device : devices) {
+    auto entries = device->jacobianEntries();
+    std::vector<double> jacobian(entries.size());
+    device->smallSignal(x, jacobian);
+    for (int k = 0; k < (int)entries.size(); k++) {
+      output.at(entries[k].first, entries[k].second) += jacobian[k];
+    }
+  }
+  output.compress();
+  return output;
+}
+
+ACResult ACSweep(const sparseMatrix<double>& A, const sparseMatrix<double>& E, const matrix<complexNumber<double>>& F, const std::vector<double>& frequencies, int threads) {
+  int n = A.rows;
+  int points = frequencies.size();
+  ACResult result;
+  result.frequency = frequencies;
+  result.solution = std::vector<std::vector<complexNumber<double>>>(points);
+
+  // Row and col 2k are the real part of unknown k and 2k + 1 the imaginary part, so each
+  // entry z of A + jwE is the 2x2 block [Re z, -Im z; Im z, Re z].
+  // Each complex row is turned by conj(z_kk)/|z_kk| first, which does not change the solution
+  // but makes the diagonal block |z_kk| I. Then the pivots stay on the diagonal like they would
+  // in a complex LU, even when wE is much bigger than A, and the fill reducing order holds
+  struct entry {
+    int row, col;
+    double a, e;
+    int slot; // where its 2x2 block starts in the real row, the imaginary row has the other two
+  };
+  std::vector<entry> entries;
+  for (int row = 0; row < n; row++) {
+    for (int p = A.rowStart[row]; p < A.rowStart[row + 1]; p++) {
+      entries.push_back({row, A.colIdx[p], A.values[p], 0.0, 0});
+    }
+    for (int p = E.rowStart[row]; p < E.rowStart[row + 1]; p++) {
+      entries.push_back({row, E.colIdx[p], 0.0, E.values[p], 0});
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const entry& x, const entry& y) {
+    return x.row < y.row || (x.row == y.row && x.col < y.col);
+  });
+  // The same entry can come from A and E
+  int merged = 0;
+  for (int k = 0; k < (int)entries.size(); k++) {
+    if (merged > 0 && entries[merged - 1].row == entries[k].row && entries[merged - 1].col == entries[k].col) {
+      entries[merged - 1].a += entries[k].a;
+      entries[merged - 1].e += entries[k].e;
+    } else {
+      entries[merged++] = entries[k];
+    }
+  }
+  entries.resize(merged);
+
+  sparseMatrix<double> M;
+  M.rows = M.cols = 2 * n;
+  M.rowStart.assign(2 * n + 1, 0);
+  std::vector<int> diagonal(n, -1);
+  int rowLength = 0;
+  for (int k = 0; k < merged; k++) {
+    auto& e = entries[k];
+    if (k == 0 || entries[k - 1].row != e.row) {
+      rowLength = 0;
+    }
+    M.rowStart[2 * e.row + 1] += 2;
+    M.rowStart[2 * e.row + 2] += 2;
+    e.slot = rowLength;
+    rowLength += 2;
+    if (e.row == e.col) {
+      diagonal[e.row] = k;
+    }
+  }
+  for (int row = 0; row < 2 * n; row++) {
+    M.rowStart[row + 1] += M.rowStart[row];
+  }
+  M.colIdx.resize(M.rowStart[2 * n]);
+  M.values.resize(M.rowStart[2 * n]);
+  for (auto& e : entries) {
+    for (int part = 0; part < 2; part++) {
+      int start = M.rowStart[2 * e.row + part] + e.slot;
+      M.colIdx[start] = 2 * e.col;
+      M.colIdx[start + 1] = 2 * e.col + 1;
+    }
+  }
+
+  auto solveRange = [&](int first, int last) {
+    sparseMatrix<double> Mw = M;
+    sparseLU MLU;
+    std::vector<complexNumber<double>> turn(n);
+    std::vector<double> x(2 * n);
+    for (int i = first; i < last; i++) {
+      double w = 2 * M_PI * frequencies[i];
+      for (int row = 0; row < n; row++) {
+        turn[row] = complexNumber<double>(1.0, 0.0);
+        if (diagonal[row] >= 0) {
+          double re = entries[diagonal[row]].a;
+          double im = w * entries[diagonal[row]].e;
+          double size = std::hypot(re, im);
+          if (size > 0.0) {
+            turn[row] = complexNumber<double>(re / size, -im / size);
+          }
+        }
+      }
+      for (auto& e : entries) {
+        auto& u = turn[e.row];
+        double re = u.a * e.a - u.b * w * e.e;
+        double im = u.a * w * e.e + u.b * e.a;
+        int realRow = M.rowStart[2 * e.row] + e.slot;
+        int imaginaryRow = M.rowStart[2 * e.row + 1] + e.slot;
+        Mw.values[realRow] = re;
+        Mw.values[realRow + 1] = -im;
+        Mw.values[imaginaryRow] = im;
+        Mw.values[imaginaryRow + 1] = re;
+      }
+      MLU.factor(Mw);
+      for (int row = 0; row < n; row++) {
+        auto& u = turn[row];
+        auto& b = F.data[row];
+        x[2 * row] = u.a * b.a - u.b * b.b;
+        x[2 * row + 1] = u.a * b.b + u.b * b.a;
+      }
+      MLU.solveInPlace(x);
+      result.solution[i] = std::vector<complexNumber<double>>(n);
+      for (int row = 0; row < n; row++) {
+        result.solution[i][row] = complexNumber<double>(x[2 * row], x[2 * row + 1]);
+      }
+    }
+  };
+
+  threadPool pool(threads);
+  if (pool.size() <= 1 || points <= 1) {
+    solveRange(0, points);
+    return result;
+  }
+  int chunks = std::min(points, 4 * pool.size());
+  parallelFor(pool, chunks, [&](int chunk) {
+    solveRange(chunk * points / chunks, (chunk + 1) * points / chunks);
+  });
+  return result;
+}
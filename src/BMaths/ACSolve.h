@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include "matrix.h"
+#include "sparseMatrix.h"
+#include "denseLU.h"
+#include "complexNumbers.h"
+#include "nonlinearDevice.h"
+
+// Small signal AC analysis of Ax + Ex' = f.
+// With x = X e^(jwt) the DAE becomes (A + jwE) X = F, which is solved in
+// complex arithmetic once per frequency. The frequencies do not depend on each
+// other so they are split into chunks on a threadPool, each with its own LU.
+// The sparse sweep solves it as a real system of twice the size with sparseLU, the real and
+// imaginary parts of each unknown side by side. The pattern is the same at every frequency so
+// the ordering is only found once.
+struct ACResult {
+  std::vector<double> frequency;
+  // solution[i] is the solution at frequency[i]
+  std::vector<std::vector<complexNumber<double>>> solution;
+};
+
+// points frequencies spaced logarithmically from start to stop, in Hz
+std::vector<double> createLogFrequencies(double start, double stop, int points);
+
+ACResult ACSweep(const matrix<double>& A, const matrix<double>& E, const matrix<complexNumber<double>>& F, const std::vector<double>& frequencies, int threads = 0);
+// A plus the conductances of the devices at the operating point x, so the sweep sees their small signal model
+matrix<double> linearizeDevices(const matrix<double>& A, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, const std::vector<double>& x);
+sparseMatrix<double> linearizeDevices(const sparseMatrix<double>& A, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, const std::vector<double>& x);
+
+ACResult ACSweep(const sparseMatrix<double>& A, const sparseMatrix<double>& E, const matrix<complexNumber<double>>& F, const std::vector<double>& frequencies, int threads = 0);
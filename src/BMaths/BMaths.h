@@ -7,9 +7,24 @@
 #include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include "vectorKernels.h"
+#include "blockedKernels.h"
 #include "matrix.h"
+#include "sparseMatrix.h"
+#include "ordering.h"
+#include "sparseLU.h"
+#include "fixedMatrix.h"
+#include "denseLU.h"
 #include "function.h"
+#include "compiledFunction.h"
 #include "DAESolve.h"
+#include "compiledDAE.h"
+#include "nonlinearDevice.h"
+#include "newtonSolver.h"
+#include "DCSolve.h"
+#include "ACSolve.h"
+#include "threadPool.h"
+#include "resultSink.h"
 #include "algebraicEquationSolver.h"
 #include "complexNumbers.h"
 #include "fourierTransform.h"
@@ -24,12 +24,8 @@ std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve(matrix<doub
   return output;
 }
 
-matrix<double> getRowsFromIdx(matrix<double> input, std::vector<int>& idx) {
-  matrix<double> output = {std::vector<std::vector<double>>{}, input.cols, (int)idx.size()};
-  for (auto& row : idx) {
-    output.data.push_back(input.getRow(row).transpose().data[0]);
-  }
-  return output;
+matrix<double> getRowsFromIdx(const matrix<double>& input, const std::vector<int>& idx) {
+  return input.getIndexView(idx, createIdxRange(input.cols)).copy();
 }
 
 std::vector<int> getDEColIdx(matrix<double> E) {
@@ -37,7 +33,7 @@ std::vector<int> getDEColIdx(matrix<double> E) {
   for (int col = 0; col < E.cols; col++) {
     bool isZero = false;
     for (int row = 0; row < E.rows; row++) {
-      if (E.data[row][col] != 0.0) {
+      if (E[row][col] != 0.0) {
         isZero = true;
       }
     }
@@ -48,13 +44,19 @@ std::vector<int> getDEColIdx(matrix<double> E) {
   return DEColIdx;
 }
 
-matrix<double> eliminateColsFromIdx(matrix<double> input, std::vector<int>& idx) {
-  int i = 0;
+// The returned view points into input so input must outlive it
+matrixIndexView<double> eliminateColsFromIdx(const matrix<double>& input, const std::vector<int>& idx) {
+  std::vector<bool> isEliminated(input.cols, false);
   for (auto col : idx) {
-    input.eliminateCol(col - i);
-    i++;
+    isEliminated[col] = true;
   }
-  return input;
+  std::vector<int> colIdx;
+  for (int col = 0; col < input.cols; col++) {
+    if (!isEliminated[col]) {
+      colIdx.push_back(col);
+    }
+  }
+  return input.getIndexView(createIdxRange(input.rows), colIdx);
 }
 
 matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
@@ -64,7 +66,7 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
   for (int row = 0; row < E.rows; ++row) {
     bool isDE = false;
     for (int col = 0; col < E.cols; ++col) {
-      if (E.data[row][col] != 0.0) {
+      if (E[row][col] != 0.0) {
         isDE = true;
       }
     }
@@ -78,7 +80,7 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
   for (int row = 0; row < E.rows; ++row) {
     bool isAE = true;
     for (int col = 0; col < E.cols; ++col) {
-      if (E.data[row][col] != 0.0) {
+      if (E[row][col] != 0.0) {
         isAE = false;
       }
     }
@@ -87,24 +89,18 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
     }
   }
   
-  matrix<double> EDE = {std::vector<std::vector<double>>{}, E.cols, (int)DERowIdx.size()};
-  matrix<double> ADE = {std::vector<std::vector<double>>{}, A.cols, (int)DERowIdx.size()};
-  matrix<double> fDE = {std::vector<std::vector<double>>{}, f.cols, (int)DERowIdx.size()};
-  matrix<double> ynDE = {std::vector<std::vector<double>>{}, yn.cols, (int)DERowIdx.size()};
+  auto EDE = getRowsFromIdx(E, DERowIdx);
+  auto ADE = getRowsFromIdx(A, DERowIdx);
+  auto fDE = getRowsFromIdx(f, DERowIdx);
+  auto ynDE = getRowsFromIdx(yn, DERowIdx);
 
   int i = 0;
-  for (auto row : DERowIdx) {
-    EDE.data.push_back(E.getRow(row).transpose().data[0]);
-    ADE.data.push_back(A.getRow(row).transpose().data[0]);
-    fDE.data.push_back(f.getRow(row).transpose().data[0]);
-    ynDE.data.push_back(yn.getRow(row).transpose().data[0]);
-  }
 
   std::vector<int> AEColIdx;
   for (int col = 0; col < E.cols; col++) {
     bool isZero = true;
     for (int row = 0; row < E.rows; row++) {
-      if (E.data[row][col] != 0.0) {
+      if (E[row][col] != 0.0) {
         isZero = false;
       }
     }
@@ -119,13 +115,13 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
   }
   //EDE.print();
 
-  auto xn1 = ((EDE.invert() * (fDE -(ADE * yn))).scale(timeStep) + ynDE);
+  auto xn1 = ((denseLU<double>(EDE).solve(fDE -(ADE * yn))).scale(timeStep) + ynDE);
   //xn1.print();
 
-  matrix<double> xn1New = {std::vector<std::vector<double>>(f.rows, std::vector<double>(f.cols, 0.0)), f.cols, f.rows};
+  matrix<double> xn1New = createMatrix<double>(f.rows, f.cols);
   i = 0;
   for (auto row : DERowIdx) {
-    xn1New.data[row][0] = xn1.data[i][0];
+    xn1New[row][0] = xn1[i][0];
     i++;
   }
   
@@ -141,7 +137,7 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
   for (int col = 0; col < E.cols; col++) {
     bool isZero = false;
     for (int row = 0; row < E.rows; row++) {
-      if (E.data[row][col] != 0.0) {
+      if (E[row][col] != 0.0) {
         isZero = true;
       }
     }
@@ -175,13 +171,11 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
 
   auto AEsols = NewtonsMethod(An, newf, NewtonGuess);
 
-  matrix<double> AEsolsNew = {std::vector<std::vector<double>>(
-                                                               f.rows, std::vector<double>(f.cols, 0.0)),
-                              f.cols, f.rows};
+  matrix<double> AEsolsNew = createMatrix<double>(f.rows, f.cols);
 
   i = 0;
   for (auto row : AERowIdx) {
-    AEsolsNew.data[row][0] = AEsols.data[i][0];
+    AEsolsNew[row][0] = AEsols[i][0];
     i++;
   }
   auto output = (AEsolsNew + xn1New);
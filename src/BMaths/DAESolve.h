@@ -1,8 +1,11 @@
 #pragma once
 #include "matrix.h"
+#include "sparseMatrix.h"
+#include "sparseLU.h"
 #include "algebraicEquationSolver.h"
 #include "differentialEquationSolver.h"
 #include "function.h"
+#include "resultSink.h"
 
 template<typename T1, typename T2, typename T3>
 struct DifferentialAlgebraicEquation {
@@ -12,13 +15,22 @@ struct DifferentialAlgebraicEquation {
   matrix<symbol> syms;
 };
 
+// Same as above but A and E are stored sparse, used for large circuits
+template<typename T3>
+struct SparseDifferentialAlgebraicEquation {
+  sparseMatrix<double> A;
+  sparseMatrix<double> E;
+  matrix<T3> f;
+  matrix<symbol> syms;
+};
+
 
 
 std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve(matrix<double> A, matrix<double> E, matrix<double> f, matrix<double> initalGuess, double timeStep, double timeEnd);
 
 
-matrix<double> getRowsFromIdx(matrix<double> input, std::vector<int>& idx);
-matrix<double> eliminateColsFromIdx(matrix<double> input, std::vector<int>& idx);
+matrix<double> getRowsFromIdx(const matrix<double>& input, const std::vector<int>& idx);
+matrixIndexView<double> eliminateColsFromIdx(const matrix<double>& input, const std::vector<int>& idx);
 std::vector<int> getDEColIdx(matrix<double> E);
 
 matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f, matrix<double> yn, double timeStep);
@@ -28,10 +40,10 @@ matrix<double> DAEStepper(matrix<double> A, matrix<double> E, matrix<double> f,
 
 template<typename T1, typename T2, typename T3>
 std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve2(DifferentialAlgebraicEquation<T1, T2, T3> DAE, matrix<double> initalGuess, double timeStep, double timeEnd) {
-  std::vector<matrix<double>> results;
-  std::vector<double> time;
   int steps = ceil(timeEnd/timeStep);
-  results.reserve(steps);
+  columnStoreSink store;
+  store.begin(DAE.f.rows, steps);
+  matrix<double> yn = initalGuess;
   auto DEIdx = getDifferentailEquationIdxFromDAE(DAE);
   auto DEColIdx = getDEColIdx(DAE.E);
   auto DEs = getDifferentailEquationsFromDAE(DAE);
@@ -39,15 +51,19 @@ std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve2(Differenti
   auto AEIdx = getAlgebraicEquationIdxFromDAE(DAE);
   auto AEs = getAlgebraicEquationsFromDAE(DAE);
   //AEs.A.print("A");
+  // E and A do not change so they are factored once before stepping
+  denseLU<double> EDELU(DEs.E);
+  // An indexes into AEs.A, no copy is made
+  auto An = eliminateColsFromIdx(AEs.A, DEColIdx);
+  denseLU<double> AnLU;
+  AnLU.factor(An);
+  if (EDELU.isSingular || AnLU.isSingular) {
+    std::cerr << "ERROR: The DAE can not be solved, E or the AE block is singular" << std::endl;
+    return store.take();
+  }
     
   for (int i = 0; i < steps; i++) {
     double tn = i * timeStep - timeStep;
-    matrix<double> yn;
-    if (results.size() == 0) {
-      yn = initalGuess;
-    } else {
-      yn = results[results.size() - 1];
-    }
     
     auto ynDE = getRowsFromIdx(yn, DEIdx);
     matrix<double> xn1;
@@ -57,15 +73,13 @@ std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve2(Differenti
     } else if constexpr (std::is_same<T3, function>::value) {
       matrix<double> DEsfEval = DEs.f.evaluate(tn);
       //auto E2 = DEs.E.scale(0.25);
-      xn1 = ((DEs.E.invert() * (DEsfEval - (DEs.A * yn))).scale(timeStep) + ynDE);
+      xn1 = (EDELU.solve(DEsfEval - (DEs.A * yn)).scale(timeStep) + ynDE);
     }
 
-    auto An = eliminateColsFromIdx(AEs.A, DEColIdx);
-
-    matrix<double> xn1New = {std::vector<std::vector<double>>(DAE.f.rows, std::vector<double>(DAE.f.cols, 0.0)), DAE.f.cols, DAE.f.rows};
+    matrix<double> xn1New = createMatrix<double>(DAE.f.rows, DAE.f.cols);
     int j = 0;
     for (auto row : DEIdx) {
-      xn1New.data[row][0] = xn1.data[j][0];
+      xn1New[row][0] = xn1[j][0];
       j++;
     }
     auto An1xn1 = (AEs.A * xn1New);
@@ -77,48 +91,96 @@ std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve2(Differenti
       newf = (AEfEval - An1xn1);
     }
 
-    auto NewtonGuess = yn;
-    j = 0;
-    for (auto row : DEIdx) {
-      NewtonGuess.eliminateRow(row - j);
-      j++;
-    }
+    auto NewtonGuess = getRowsFromIdx(yn, AEIdx);
     //newf.print("newf");
-    auto AEsols = NewtonsMethod(An, newf, NewtonGuess);
-
-    matrix<double> AEsolsNew = {std::vector<std::vector<double>>(
-                                                                 DAE.f.rows, std::vector<double>(DAE.f.cols, 0.0)),
-                                DAE.f.cols, DAE.f.rows};
+    auto AEsols = NewtonsMethod(An, AnLU, newf, NewtonGuess);
 
     j = 0;
     for (auto row : AEIdx) {
-      AEsolsNew.data[row][0] = AEsols.data[j][0];
+      xn1New[row][0] += AEsols[j][0];
       j++;
     }
-    auto nextStep = AEsolsNew + xn1New;
-    results.push_back(nextStep);
-    time.push_back(tn);
+    store.add(tn, xn1New.data);
+    yn = std::move(xn1New);
   };
-  
-  std::vector<matrix<double>> resultsReformated;
-  for (auto& r : results) {
-    matrix<double> m = {
-      {{}},
-      0, 1
-    };
-    resultsReformated.push_back(m);
-  }
-  for (auto& r : results) {
-    for (int row = 0; row < results[0].rows; row++) {
-      resultsReformated[row].data[0].push_back(r.data[row][0]);
-      resultsReformated[row].cols++;
+  return store.take();
+}
+
+
+// The sparse version of DAESolve2, A and E do not change so the DE and AE
+// blocks are split and factored once before stepping
+template<typename T3>
+std::pair<std::vector<double>, std::vector<matrix<double>>> DAESolve2(SparseDifferentialAlgebraicEquation<T3> DAE, matrix<double> initalGuess, double timeStep, double timeEnd) {
+  int steps = ceil(timeEnd/timeStep);
+  columnStoreSink store;
+  store.begin(DAE.f.rows, steps);
+  matrix<double> yn = initalGuess;
+
+  auto DEIdx = DAE.E.nonEmptyRows();
+  auto DEColIdx = DAE.E.nonEmptyCols();
+  std::vector<int> AEIdx, AEColIdx, allCols;
+  {
+    std::vector<bool> isDERow(DAE.E.rows, false), isDECol(DAE.E.cols, false);
+    for (auto row : DEIdx) isDERow[row] = true;
+    for (auto col : DEColIdx) isDECol[col] = true;
+    for (int row = 0; row < DAE.E.rows; row++) {
+      if (!isDERow[row]) AEIdx.push_back(row);
+    }
+    for (int col = 0; col < DAE.E.cols; col++) {
+      if (!isDECol[col]) AEColIdx.push_back(col);
+      allCols.push_back(col);
     }
   }
 
-  auto output = std::pair<std::vector<double>, std::vector<matrix<double>>>{time, resultsReformated};
-  return output;
-}
+  auto EDE = DAE.E.getSubMatrix(DEIdx, DEColIdx);
+  auto ADE = DAE.A.getSubMatrix(DEIdx, allCols);
+  auto AAE = DAE.A.getSubMatrix(AEIdx, allCols);
+  auto An = DAE.A.getSubMatrix(AEIdx, AEColIdx);
+  sparseLU EDELU(EDE);
+  sparseLU AnLU(An);
+  if (EDELU.isSingular || AnLU.isSingular) {
+    std::cerr << "ERROR: The DAE can not be solved, E or the AE block is singular" << std::endl;
+    return store.take();
+  }
 
+  auto fDE = DAE.f.getIndexView(DEIdx, {0}).copy();
+  auto fAE = DAE.f.getIndexView(AEIdx, {0}).copy();
+
+  for (int i = 0; i < steps; i++) {
+    double tn = i * timeStep - timeStep;
+
+    auto ynDE = getRowsFromIdx(yn, DEIdx);
+    matrix<double> DEsfEval;
+    matrix<double> AEfEval;
+    if constexpr (std::is_arithmetic<T3>::value) {
+      DEsfEval = fDE;
+      AEfEval = fAE;
+    } else if constexpr (std::is_same<T3, function>::value) {
+      DEsfEval = fDE.evaluate(tn);
+      AEfEval = fAE.evaluate(tn);
+    }
+    auto xn1 = EDELU.solve(DEsfEval - (ADE * yn)).scale(timeStep) + ynDE;
+
+    matrix<double> xn1New = createMatrix<double>(DAE.f.rows, 1);
+    int j = 0;
+    for (auto row : DEIdx) {
+      xn1New[row][0] = xn1[j][0];
+      j++;
+    }
+    auto newf = AEfEval - (AAE * xn1New);
+    auto NewtonGuess = getRowsFromIdx(yn, AEIdx);
+    auto AEsols = NewtonsMethod(An, AnLU, newf, NewtonGuess);
+
+    j = 0;
+    for (auto row : AEIdx) {
+      xn1New[row][0] += AEsols[j][0];
+      j++;
+    }
+    store.add(tn, xn1New.data);
+    yn = std::move(xn1New);
+  };
+  return store.take();
+}
 
 template<typename T1, typename T2, typename T3>
 std::vector<int> getDifferentailEquationIdxFromDAE(DifferentialAlgebraicEquation<T1, T2, T3> DAE) {
@@ -126,7 +188,7 @@ std::vector<int> getDifferentailEquationIdxFromDAE(DifferentialAlgebraicEquation
   for (int row = 0; row < DAE.E.rows; ++row) {
     bool isDE = false;
     for (int col = 0; col < DAE.E.cols; ++col) {
-      if (DAE.E.data[row][col] != 0.0) {
+      if (DAE.E[row][col] != 0.0) {
         isDE = true;
       }
     }
@@ -144,7 +206,7 @@ std::vector<int> getAlgebraicEquationIdxFromDAE(DifferentialAlgebraicEquation<T1
   for (int row = 0; row < DAE.E.rows; ++row) {
     bool isDE = true;
     for (int col = 0; col < DAE.E.cols; ++col) {
-      if (DAE.E.data[row][col] != 0.0) {
+      if (DAE.E[row][col] != 0.0) {
         isDE = false;
       }
     }
@@ -162,43 +224,27 @@ std::vector<int> getAlgebraicEquationIdxFromDAE(DifferentialAlgebraicEquation<T1
 template<typename T1, typename T2, typename T3>
 DifferentialEquation<T1, T2, T3> getDifferentailEquationsFromDAE(DifferentialAlgebraicEquation<T1, T2, T3> DAE) {
   auto DERowIdx = getDifferentailEquationIdxFromDAE(DAE);
-  //auto AERowIdx = getAlgebraicEquationIdxFromDAE(DAE);
-  matrix<T1> ADE = {std::vector<std::vector<T1>>{}, DAE.A.cols, (int)DERowIdx.size()};
-  matrix<T2> EDE = {std::vector<std::vector<T2>>{}, DAE.E.cols, (int)DERowIdx.size()};
-  matrix<T3> fDE = {std::vector<std::vector<T3>>{}, DAE.f.cols, (int)DERowIdx.size()};
-  matrix<symbol> symsDE = {std::vector<std::vector<symbol>>{}, DAE.syms.cols, (int)DERowIdx.size()};
-
-  for (auto& row : DERowIdx) {
-    EDE.data.push_back(DAE.E.getRow(row).transpose().data[0]);
-    ADE.data.push_back(DAE.A.getRow(row).transpose().data[0]);
-    fDE.data.push_back(DAE.f.getRow(row).transpose().data[0]);
-    symsDE.data.push_back(DAE.syms.getRow(row).transpose().data[0]);
-  }
-
+  auto allCols = createIdxRange(DAE.A.cols);
 
-  std::vector<int> AEColIdx;
+  // Cols of E that are all zero belong to the algebraic equations
+  std::vector<int> DEColIdx;
   for (int col = 0; col < DAE.E.cols; col++) {
     bool isZero = true;
     for (int row = 0; row < DAE.E.rows; row++) {
-      if (DAE.E.data[row][col] != 0.0) {
+      if (DAE.E[row][col] != 0.0) {
         isZero = false;
       }
     }
-    if (isZero) {
-      AEColIdx.push_back(col);
+    if (!isZero) {
+      DEColIdx.push_back(col);
     }
   }
-  int i = 0;
-  for (auto col : AEColIdx) {
-    EDE.eliminateCol(col - i);
-    i++;
-  }
   
   DifferentialEquation<T1, T2, T3> DE;
-  DE.E = EDE;
-  DE.A = ADE;
-  DE.f = fDE;
-  DE.syms = symsDE;
+  DE.E = DAE.E.getIndexView(DERowIdx, DEColIdx).copy();
+  DE.A = DAE.A.getIndexView(DERowIdx, allCols).copy();
+  DE.f = DAE.f.getIndexView(DERowIdx, createIdxRange(DAE.f.cols)).copy();
+  DE.syms = DAE.syms.getIndexView(DERowIdx, createIdxRange(DAE.syms.cols)).copy();
   return DE;
 }
 
@@ -206,21 +252,9 @@ DifferentialEquation<T1, T2, T3> getDifferentailEquationsFromDAE(DifferentialAlg
 template<typename T1, typename T2, typename T3>
 AlgebraicEquation<T1, T2> getAlgebraicEquationsFromDAE(DifferentialAlgebraicEquation<T1, T3, T2> DAE) {
   auto AERowIdx = getAlgebraicEquationIdxFromDAE(DAE);
-  matrix<T3> EAE = {std::vector<std::vector<T3>>{}, DAE.E.cols, (int)AERowIdx.size()};
-  matrix<T1> AAE = {std::vector<std::vector<T1>>{}, DAE.A.cols, (int)AERowIdx.size()};
-  matrix<T2> fAE = {std::vector<std::vector<T2>>{}, DAE.f.cols, (int)AERowIdx.size()};
-  matrix<symbol> symsAE = {std::vector<std::vector<symbol>>{}, DAE.syms.cols, (int)AERowIdx.size()};
-
-  for (auto& row : AERowIdx) {
-    EAE.data.push_back(DAE.E.getRow(row).transpose().data[0]);
-    AAE.data.push_back(DAE.A.getRow(row).transpose().data[0]);
-    fAE.data.push_back(DAE.f.getRow(row).transpose().data[0]);
-    symsAE.data.push_back(DAE.syms.getRow(row).transpose().data[0]);
-  }
   AlgebraicEquation<T1, T2> AE;
-  AE.A = AAE;
-  AE.f = fAE;
-  AE.syms = symsAE;
+  AE.A = DAE.A.getIndexView(AERowIdx, createIdxRange(DAE.A.cols)).copy();
+  AE.f = DAE.f.getIndexView(AERowIdx, createIdxRange(DAE.f.cols)).copy();
+  AE.syms = DAE.syms.getIndexView(AERowIdx, createIdxRange(DAE.syms.cols)).copy();
   return AE;
 }
-
@@ -0,0 +1,32 @@
+#include "DCSolve.h"
+
+bool DCNewton(const sparseMatrix<double>& A, const std::vector<double>& f, int nodeCount, double gmin, double sourceScale, const DCOptions& options, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, std::vector<double>& x) {
+  int n = A.rows;
+  // The linear part is A + gmin on the node rows
+  sparseMatrix<double> M = A;
+  for (int node = 0; node < nodeCount; node++) {
+    M.at(node, node) += gmin;
+  }
+  M.compress();
+
+  newtonSolver newton(devices);
+  newton.options.maxIt = options.maxIt;
+  newton.options.absTol = options.eps;
+  newton.options.relTol = options.eps;
+  newton.setLinear(M);
+  std::vector<double> b(n);
+  for (int row = 0; row < n; row++) {
+    b[row] = sourceScale * f[row];
+  }
+  std::vector<double> result = x;
+  if (!newton.solve(b, result)) {
+    return false;
+  }
+  for (int row = 0; row < n; row++) {
+    if (!std::isfinite(result[row])) {
+      return false;
+    }
+  }
+  x = result;
+  return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <type_traits>
+#include "matrix.h"
+#include "sparseMatrix.h"
+#include "sparseLU.h"
+#include "function.h"
+#include "newtonSolver.h"
+
+// DC operating point of Ax + Ex' = f.
+// At DC x' = 0 so only A is used, the capacitors (only in E) are open and the
+// inductors (v1 - v2 - L di/dt = 0) are shorts. A small conductance gmin is put
+// from every node to ground so nodes that are only connected through capacitors
+// still have a solution.
+// If Newton does not converge straight away gmin stepping is tried, starting with a
+// large gmin and reducing it, then source stepping, where the sources are ramped
+// up from zero. Each solve starts from the one before.
+struct DCOptions {
+  double gmin = 1e-12;
+  double gminStart = 1e-2;
+  int sourceSteps = 10;
+  int maxIt = 100;
+  double eps = 1e-9;
+};
+
+// One Newton solve of (A + gmin) x + i(x) = sourceScale f, x is the guess and the result
+bool DCNewton(const sparseMatrix<double>& A, const std::vector<double>& f, int nodeCount, double gmin, double sourceScale, const DCOptions& options, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, std::vector<double>& x);
+
+template<typename T3>
+std::vector<double> evaluateSources(const matrix<T3>& f, double t) {
+  std::vector<double> output(f.rows);
+  for (int row = 0; row < f.rows; row++) {
+    if constexpr (std::is_arithmetic<T3>::value) {
+      output[row] = f[row][0];
+    } else {
+      output[row] = f[row][0].evaluate(t);
+    }
+  }
+  return output;
+}
+
+// nodeCount is the number of node voltages, they are the first unknowns.
+// The sources are evaluated at time t. devices are the nonlinear parts, like diodes.
+// Returns false if no operating point was found.
+template<typename T3>
+bool DCOperatingPoint(const sparseMatrix<double>& A, const matrix<T3>& f, int nodeCount, double t, matrix<double>& x,
+                      const std::vector<std::shared_ptr<nonlinearDevice>>& devices = {}, const DCOptions& options = DCOptions()) {
+  auto fEval = evaluateSources(f, t);
+  std::vector<double> guess(A.rows, 0.0);
+  if (x.rows == A.rows) {
+    guess = x.data;
+  }
+
+  std::vector<double> result = guess;
+  bool converged = DCNewton(A, fEval, nodeCount, options.gmin, 1.0, options, devices, result);
+
+  if (!converged) {
+    std::cout << "DC operating point: trying gmin stepping" << std::endl;
+    result = guess;
+    converged = true;
+    for (double gmin = options.gminStart; gmin > options.gmin && converged; gmin /= 10.0) {
+      converged = DCNewton(A, fEval, nodeCount, gmin, 1.0, options, devices, result);
+    }
+    if (converged) {
+      converged = DCNewton(A, fEval, nodeCount, options.gmin, 1.0, options, devices, result);
+    }
+  }
+
+  if (!converged) {
+    std::cout << "DC operating point: trying source stepping" << std::endl;
+    result = std::vector<double>(A.rows, 0.0);
+    converged = true;
+    for (int i = 1; i <= options.sourceSteps && converged; i++) {
+      double sourceScale = (double)i / options.sourceSteps;
+      converged = DCNewton(A, fEval, nodeCount, options.gmin, sourceScale, options, devices, result);
+    }
+  }
+
+  if (!converged) {
+    std::cerr << "ERROR: Unable to find the DC operating point" << std::endl;
+    return false;
+  }
+  x.rows = A.rows;
+  x.cols = 1;
+  x.data = result;
+  return true;
+}
+
+template<typename T3>
+bool DCOperatingPoint(const matrix<double>& A, const matrix<T3>& f, int nodeCount, double t, matrix<double>& x,
+                      const std::vector<std::shared_ptr<nonlinearDevice>>& devices = {}, const DCOptions& options = DCOptions()) {
+  return DCOperatingPoint(createSparseFromDense(A), f, nodeCount, t, x, devices, options);
+}
@@ -2,6 +2,15 @@
 // solve matrix equtations of the form A x = f
 matrix<double> NewtonsMethod(matrix<double> A, matrix<double> f,
                              matrix<double> guess) {
+  // Jacobian == A, this is only for linear systems so it does not change
+  // between iterations and is only factored once. Nonlinear systems use the
+  // overload that takes the devices
+  denseLU<double> J(A);
+  return NewtonsMethod(A.getIndexView(createIdxRange(A.rows), createIdxRange(A.cols)), J, f, guess);
+};
+
+matrix<double> NewtonsMethod(const matrixIndexView<double>& A, const denseLU<double>& J,
+                             matrix<double> f, matrix<double> guess) {
   
   // Jacobian
   // For now we are only dealing with first order polynomials
@@ -9,11 +18,9 @@ matrix<double> NewtonsMethod(matrix<double> A, matrix<double> f,
   int maxIt = 100000;
   const double eps = 1e-4;
   for (int i = 0; i < maxIt; i++) {
-    // FIXME: Jacobian == A, as we are dealing with first order polynomials
-    auto J = A;
     auto F = (A * guess) - f;
     // d = -J(-1)*F
-    auto delta = J.invert().scale(-1) * F;
+    auto delta = J.solve(F).scale(-1);
     guess = guess + delta;
 
     
@@ -30,3 +37,41 @@ matrix<double> NewtonsMethod(matrix<double> A, matrix<double> f,
   }
   return guess;
 };
+
+matrix<double> NewtonsMethod(const sparseMatrix<double>& A, matrix<double> f,
+                             matrix<double> guess) {
+  sparseLU J(A);
+  return NewtonsMethod(A, J, f, guess);
+}
+
+matrix<double> NewtonsMethod(const sparseMatrix<double>& A, const std::vector<std::shared_ptr<nonlinearDevice>>& devices,
+                             matrix<double> f, matrix<double> guess) {
+  newtonSolver newton(devices);
+  newton.setLinear(A);
+  if (!newton.solve(f.data, guess.data)) {
+    std::cerr << "Newtons method did not converge" << std::endl;
+  }
+  return guess;
+}
+
+// J is the factored Jacobian, this is the same as A so it only needs
+// to be factored once by the caller
+matrix<double> NewtonsMethod(const sparseMatrix<double>& A, const sparseLU& J,
+                             matrix<double> f, matrix<double> guess) {
+  int maxIt = 100000;
+  const double eps = 1e-4;
+  for (int i = 0; i < maxIt; i++) {
+    auto F = (A * guess) - f;
+    auto delta = J.solve(F).scale(-1);
+    guess = guess + delta;
+
+    if (delta.norm(2) < eps) {
+      break;
+    }
+    if (i >= maxIt - 1) {
+      std::cerr << "Newtons method did not converge" << std::endl;
+      std::cout << "||delta||_2: " << std::scientific << std::setprecision(4) << delta.norm(2) << std::endl;
+    }
+  }
+  return guess;
+};
@@ -1,5 +1,9 @@
 #pragma once
 #include "matrix.h"
+#include "sparseMatrix.h"
+#include "sparseLU.h"
+#include "denseLU.h"
+#include "newtonSolver.h"
 
 // of the form Ax = f
 template<typename T1, typename T2>
@@ -10,4 +14,9 @@ struct AlgebraicEquation {
 };
 
 matrix<double> NewtonsMethod(matrix<double> A, matrix<double> f, matrix<double> guess);
+matrix<double> NewtonsMethod(const matrixIndexView<double>& A, const denseLU<double>& J, matrix<double> f, matrix<double> guess);
+matrix<double> NewtonsMethod(const sparseMatrix<double>& A, matrix<double> f, matrix<double> guess);
+matrix<double> NewtonsMethod(const sparseMatrix<double>& A, const sparseLU& J, matrix<double> f, matrix<double> guess);
+// A x + i(x) = f, the devices give i(x) and its analytic Jacobian
+matrix<double> NewtonsMethod(const sparseMatrix<double>& A, const std::vector<std::shared_ptr<nonlinearDevice>>& devices, matrix<double> f, matrix<double> guess);
 
@@ -0,0 +1,290 @@
+#include "blockedKernels.h"
+#include "vectorKernels.h"
+#include "threadPool.h"
+#include <vector>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BLOCKED_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The register block is MR x NR, a packed A panel is MC x KC and a packed B panel KC x NC.
+// KC x NC doubles is 512KB so a B panel stays in L2
+const int MR = 6, NR = 8;
+const int MC = 96, KC = 256, NC = 256;
+// Panel width of the LU and block size of the solves
+const int NB = 64;
+
+// Only made when more than one thread is asked for
+std::unique_ptr<threadPool> pool;
+
+// c (ldc apart) += a b over kc, a is MR wide and b is NR wide
+void microScalar(int kc, const double* a, const double* b, double* c, int ldc) {
+  double sum[MR][NR] = {};
+  for (int k = 0; k < kc; k++) {
+    for (int r = 0; r < MR; r++) {
+      for (int j = 0; j < NR; j++) {
+        sum[r][j] += a[r] * b[j];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+  for (int r = 0; r < MR; r++) {
+    for (int j = 0; j < NR; j++) {
+      c[r * ldc + j] += sum[r][j];
+    }
+  }
+}
+
+#ifdef BLOCKED_KERNELS_X86
+// 12 accumulators, the two B loads and a broadcast still fit in the 16 registers
+__attribute__((target("avx2,fma")))
+void microAVX2(int kc, const double* a, const double* b, double* c, int ldc) {
+  __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+  __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+  __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+  __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+  __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+  __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+  for (int k = 0; k < kc; k++) {
+    __m256d b0 = _mm256_loadu_pd(b);
+    __m256d b1 = _mm256_loadu_pd(b + 4);
+    __m256d ar;
+    ar = _mm256_broadcast_sd(a + 0);
+    c00 = _mm256_fmadd_pd(ar, b0, c00);
+    c01 = _mm256_fmadd_pd(ar, b1, c01);
+    ar = _mm256_broadcast_sd(a + 1);
+    c10 = _mm256_fmadd_pd(ar, b0, c10);
+    c11 = _mm256_fmadd_pd(ar, b1, c11);
+    ar = _mm256_broadcast_sd(a + 2);
+    c20 = _mm256_fmadd_pd(ar, b0, c20);
+    c21 = _mm256_fmadd_pd(ar, b1, c21);
+    ar = _mm256_broadcast_sd(a + 3);
+    c30 = _mm256_fmadd_pd(ar, b0, c30);
+    c31 = _mm256_fmadd_pd(ar, b1, c31);
+    ar = _mm256_broadcast_sd(a + 4);
+    c40 = _mm256_fmadd_pd(ar, b0, c40);
+    c41 = _mm256_fmadd_pd(ar, b1, c41);
+    ar = _mm256_broadcast_sd(a + 5);
+    c50 = _mm256_fmadd_pd(ar, b0, c50);
+    c51 = _mm256_fmadd_pd(ar, b1, c51);
+    a += MR;
+    b += NR;
+  }
+  _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), c00));
+  _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), c01));
+  c += ldc;
+  _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), c10));
+  _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), c11));
+  c += ldc;
+  _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), c20));
+  _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), c21));
+  c += ldc;
+  _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), c30));
+  _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), c31));
+  c += ldc;
+  _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), c40));
+  _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), c41));
+  c += ldc;
+  _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), c50));
+  _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), c51));
+}
+#endif
+
+using microKernel = void (*)(int, const double*, const double*, double*, int);
+
+// B[0:kc, 0:nc] as NR wide strips, each strip is kc rows of NR, padded with zeros
+void packB(int kc, int nc, const double* B, int ldb, double* packed) {
+  for (int j0 = 0; j0 < nc; j0 += NR) {
+    int nr = std::min(NR, nc - j0);
+    for (int k = 0; k < kc; k++) {
+      const double* row = B + k * ldb + j0;
+      for (int j = 0; j < nr; j++) {
+        packed[j] = row[j];
+      }
+      for (int j = nr; j < NR; j++) {
+        packed[j] = 0.0;
+      }
+      packed += NR;
+    }
+  }
+}
+
+// alpha A[0:mc, 0:kc] as MR tall strips, each strip is kc columns of MR, padded with zeros
+void packA(int mc, int kc, double alpha, const double* A, int lda, double* packed) {
+  for (int i0 = 0; i0 < mc; i0 += MR) {
+    int mr = std::min(MR, mc - i0);
+    for (int k = 0; k < kc; k++) {
+      for (int r = 0; r < mr; r++) {
+        packed[r] = alpha * A[(i0 + r) * lda + k];
+      }
+      for (int r = mr; r < MR; r++) {
+        packed[r] = 0.0;
+      }
+      packed += MR;
+    }
+  }
+}
+
+// C[0:mc, 0:nc] += the packed panels
+void macroKernel(microKernel micro, int mc, int nc, int kc, const double* packedA, const double* packedB, double* C, int ldc) {
+  double edge[MR * NR];
+  for (int j0 = 0; j0 < nc; j0 += NR) {
+    int nr = std::min(NR, nc - j0);
+    const double* b = packedB + (j0 / NR) * kc * NR;
+    for (int i0 = 0; i0 < mc; i0 += MR) {
+      int mr = std::min(MR, mc - i0);
+      const double* a = packedA + (i0 / MR) * kc * MR;
+      double* c = C + i0 * ldc + j0;
+      if (mr == MR && nr == NR) {
+        micro(kc, a, b, c, ldc);
+      } else {
+        std::fill(edge, edge + MR * NR, 0.0);
+        micro(kc, a, b, edge, NR);
+        for (int r = 0; r < mr; r++) {
+          for (int j = 0; j < nr; j++) {
+            c[r * ldc + j] += edge[r * NR + j];
+          }
+        }
+      }
+    }
+  }
+}
+
+}
+
+void gemm(int rows, int inner, int cols, double alpha, const double* A, int lda, const double* B, int ldb, double* C, int ldc) {
+  if (rows <= 0 || inner <= 0 || cols <= 0 || alpha == 0.0) {
+    return;
+  }
+  microKernel micro = microScalar;
+#ifdef BLOCKED_KERNELS_X86
+  if (vectorKernelName() == "avx2") {
+    micro = microAVX2;
+  }
+#endif
+  std::vector<double> packedB(KC * ((NC + NR - 1) / NR) * NR);
+  std::vector<double> packedA(MC * KC);
+  int rowPanels = (rows + MC - 1) / MC;
+  for (int j0 = 0; j0 < cols; j0 += NC) {
+    int nc = std::min(NC, cols - j0);
+    for (int k0 = 0; k0 < inner; k0 += KC) {
+      int kc = std::min(KC, inner - k0);
+      packB(kc, nc, B + k0 * ldb + j0, ldb, packedB.data());
+      // Each row panel writes its own rows of C, so they can run at the same time
+      auto rowPanel = [&](int panel, double* packed) {
+        int i0 = panel * MC;
+        int mc = std::min(MC, rows - i0);
+        packA(mc, kc, alpha, A + i0 * lda + k0, lda, packed);
+        macroKernel(micro, mc, nc, kc, packed, packedB.data(), C + i0 * ldc + j0, ldc);
+      };
+      if (pool && rowPanels > 1) {
+        parallelFor(*pool, rowPanels, [&](int panel) {
+          std::vector<double> packed(MC * KC);
+          rowPanel(panel, packed.data());
+        });
+      } else {
+        for (int panel = 0; panel < rowPanels; panel++) {
+          rowPanel(panel, packedA.data());
+        }
+      }
+    }
+  }
+}
+
+bool blockedLU(double* A, int n, int* perm) {
+  for (int row = 0; row < n; row++) {
+    perm[row] = row;
+  }
+  for (int k0 = 0; k0 < n; k0 += NB) {
+    int kb = std::min(NB, n - k0);
+    int panelEnd = k0 + kb;
+    // Factor the panel, columns k0 to panelEnd of every row below k0. The swaps move whole rows
+    for (int k = k0; k < panelEnd; k++) {
+      int maxRow = k;
+      double maxEl = std::abs(A[k * n + k]);
+      for (int row = k + 1; row < n; row++) {
+        if (std::abs(A[row * n + k]) > maxEl) {
+          maxEl = std::abs(A[row * n + k]);
+          maxRow = row;
+        }
+      }
+      if (maxEl == 0.0) {
+        return false;
+      }
+      if (maxRow != k) {
+        std::swap(perm[k], perm[maxRow]);
+        std::swap_ranges(A + k * n, A + (k + 1) * n, A + maxRow * n);
+      }
+      double pivot = A[k * n + k];
+      for (int row = k + 1; row < n; row++) {
+        double factor = A[row * n + k] / pivot;
+        A[row * n + k] = factor;
+        if (factor != 0.0) {
+          axpy(-factor, A + k * n + k + 1, A + row * n + k + 1, panelEnd - k - 1);
+        }
+      }
+    }
+    int rest = n - panelEnd;
+    if (rest == 0) {
+      break;
+    }
+    // U12 = L11^-1 A12
+    for (int row = k0 + 1; row < panelEnd; row++) {
+      for (int k = k0; k < row; k++) {
+        double factor = A[row * n + k];
+        if (factor != 0.0) {
+          axpy(-factor, A + k * n + panelEnd, A + row * n + panelEnd, rest);
+        }
+      }
+    }
+    // A22 -= L21 U12
+    gemm(rest, kb, rest, -1.0, A + panelEnd * n + k0, n, A + k0 * n + panelEnd, n, A + panelEnd * n + panelEnd, n);
+  }
+  return true;
+}
+
+void blockedLUSolve(const double* LU, const int* perm, int n, double* X, int cols) {
+  std::vector<double> permuted(X, X + n * cols);
+  for (int row = 0; row < n; row++) {
+    std::copy(permuted.begin() + perm[row] * cols, permuted.begin() + (perm[row] + 1) * cols, X + row * cols);
+  }
+  // L Y = P B, a block of rows at a time
+  for (int i0 = 0; i0 < n; i0 += NB) {
+    int ib = std::min(NB, n - i0);
+    gemm(ib, i0, cols, -1.0, LU + i0 * n, n, X, cols, X + i0 * cols, cols);
+    for (int row = i0 + 1; row < i0 + ib; row++) {
+      for (int k = i0; k < row; k++) {
+        axpy(-LU[row * n + k], X + k * cols, X + row * cols, cols);
+      }
+    }
+  }
+  // U X = Y, from the bottom block up
+  for (int i0 = ((n - 1) / NB) * NB; i0 >= 0; i0 -= NB) {
+    int ib = std::min(NB, n - i0);
+    gemm(ib, n - i0 - ib, cols, -1.0, LU + i0 * n + i0 + ib, n, X + (i0 + ib) * cols, cols, X + i0 * cols, cols);
+    for (int row = i0 + ib - 1; row >= i0; row--) {
+      for (int k = row + 1; k < i0 + ib; k++) {
+        axpy(-LU[row * n + k], X + k * cols, X + row * cols, cols);
+      }
+      double pivot = LU[row * n + row];
+      for (int col = 0; col < cols; col++) {
+        X[row * cols + col] /= pivot;
+      }
+    }
+  }
+}
+
+void setDenseThreads(int threads) {
+  if (threads > 1) {
+    pool = std::make_unique<threadPool>(threads);
+  } else {
+    pool.reset();
+  }
+}
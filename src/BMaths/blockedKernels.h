@@ -0,0 +1,18 @@
+#pragma once
+
+// Cache blocked dense kernels for the mid size dense systems (a few hundred to a few thousand unknowns).
+// Every matrix is row major with a row stride (ld), so blocks of a bigger matrix can be passed in place.
+// gemm packs panels of A and B so the 6x8 register block at its core reads them in order,
+// the LU is right looking, a panel is factored and the rest of the matrix is updated with one gemm.
+
+// C += alpha A B, A is rows x inner and B is inner x cols
+void gemm(int rows, int inner, int cols, double alpha, const double* A, int lda, const double* B, int ldb, double* C, int ldc);
+
+// P A = L U in place with partial pivoting, A is n x n. L has a unit diagonal that is not stored.
+// Row i of the factors is row perm[i] of A. Returns false if A is singular
+bool blockedLU(double* A, int n, int* perm);
+// Solves A X = B for the cols columns of X in place, LU and perm are from blockedLU
+void blockedLUSolve(const double* LU, const int* perm, int n, double* X, int cols);
+
+// The number of threads gemm splits its row panels over, 1 by default
+void setDenseThreads(int threads);
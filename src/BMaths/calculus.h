@@ -23,25 +23,51 @@ std::vector<T> differentiateVector(std::vector<double> time, std::vector<T> data
 
 
 
-// \int_{0}^{t} f(x) dx
+// \int_{a}^{b} over the parabola through (a, fa), (b, fb), (c, fc), the steps can differ
+template<typename T>
+T firstParabolaStep(double a, T fa, double b, T fb, double c, T fc) {
+  double h0 = b - a;
+  double h1 = c - b;
+  return (h0/6.0)*((2.0*h0 + 3.0*h1)/(h0 + h1)*fa + (h0 + 3.0*h1)/h1*fb - h0*h0/(h1*(h0 + h1))*fc);
+}
+
+// \int_{b}^{c} over the same parabola
+template<typename T>
+T lastParabolaStep(double a, T fa, double b, T fb, double c, T fc) {
+  double h0 = b - a;
+  double h1 = c - b;
+  return (h1/6.0)*(-h1*h1/(h0*(h0 + h1))*fa + (h1 + 3.0*h0)/h0*fb + (2.0*h1 + 3.0*h0)/(h0 + h1)*fc);
+}
+
+// \int_{0}^{t} f(x) dx at every sample, trapezoidal rule.
+// A running sum so it is O(n), every step may have its own h
 template<typename T> 
-std::vector<T> integrateVectorWithTime(std::vector<double> time, std::vector<T> data) {
+std::vector<T> integrateVectorWithTime(const std::vector<double>& time, const std::vector<T>& data) {
   std::vector<T> output(data.size());
-  for (int i = 0; i < data.size(); i++) {
-    double fi = 0;
-    for (int j = 1; j < i - 1; j++) {
-      fi += data[j];
-    }
-    if (i == 0) {
-      double h = time[i + 1] - time[i];
-      output[i] = (h/2)*(data[0] + 2*fi + data[i]) ;
-    } else if (i == data.size() - 1) {
-      double h = time[i] - time[i - 1];
-      output[i] = (h/2)*(data[0] + 2*fi + data[i]) ;
-    } else {
-      double h = time[i] - time[i - 1];
-      output[i] = (h/2)*(data[0] + 2*fi + data[i]) ;
+  T total = T(0.0);
+  for (int i = 0; i < (int)data.size(); i++) {
+    if (i > 0) {
+      total = total + (time[i] - time[i - 1])*(data[i - 1] + data[i])/2.0;
     }
+    output[i] = total;
+  }
+  return output;
+}
+
+// \int_{0}^{t} f(x) dx at every sample, each step adds the integral of the parabola through
+// it and the two samples before it (the first step uses the parabola through the first three).
+// Up to sample 2 on an even grid this is Simpson's rule, after that each step is its own
+// parabola so it is not composite Simpson's rule, the error is still third order in h
+template<typename T> 
+std::vector<T> integrateVectorWithTimeSimpson(const std::vector<double>& time, const std::vector<T>& data) {
+  if (data.size() < 3) {
+    return integrateVectorWithTime(time, data);
+  }
+  std::vector<T> output(data.size());
+  output[0] = T(0.0);
+  output[1] = firstParabolaStep(time[0], data[0], time[1], data[1], time[2], data[2]);
+  for (int i = 2; i < (int)data.size(); i++) {
+    output[i] = output[i - 1] + lastParabolaStep(time[i - 2], data[i - 2], time[i - 1], data[i - 1], time[i], data[i]);
   }
   return output;
 }
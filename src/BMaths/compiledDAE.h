@@ -0,0 +1,657 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <type_traits>
+#include <string>
+#include <algorithm>
+#include "matrix.h"
+#include "sparseMatrix.h"
+#include "sparseLU.h"
+#include "denseLU.h"
+#include "function.h"
+#include "compiledFunction.h"
+#include "DAESolve.h"
+#include "newtonSolver.h"
+#include "resultSink.h"
+
+enum class integrationMethod {
+  FORWARD_EULER,
+  BACKWARD_EULER,
+  TRAPEZOIDAL,
+  BDF2
+};
+
+// The names used in the netlist, time{STOP_TIME}{TIME_STEP}{METHOD}, and by --method
+inline bool getIntegrationMethod(const std::string& name, integrationMethod& method) {
+  if (name == "FE") {
+    method = integrationMethod::FORWARD_EULER;
+  } else if (name == "BE") {
+    method = integrationMethod::BACKWARD_EULER;
+  } else if (name == "TRAP") {
+    method = integrationMethod::TRAPEZOIDAL;
+  } else if (name == "BDF2") {
+    method = integrationMethod::BDF2;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// A DAE of the form Ax + Ex' = f that has been "compiled" for stepping.
+// Everything that does not depend on time (splitting into the differential and
+// algebraic blocks, the index maps, the LU factors and the work buffers) is done
+// once in the constructor, so a step is only the source evaluation, two sparse
+// matrix vector products and two triangular solves. The sources are compiled
+// too (see compiledFunction.h), so the constant rows of f are not evaluated.
+// With FORWARD_EULER this gives the same answer as DAESolve2, which is kept as the reference.
+//
+// The implicit methods solve the whole system at once, (A + a E/h) x(n+1) = rhs,
+// with a = 1 for backward Euler, 2 for trapezoidal and 3/2 for BDF2. They are
+// A-stable so the step can be set by accuracy instead of stability. The matrix
+// only depends on h so it is factored again only when the step changes.
+//
+// Nonlinear devices (diodes) turn each implicit step into M x + i(x) = rhs, which
+// is solved by newtonSolver starting from the last point. The Jacobian is reused
+// across iterations and steps until the convergence slows down. Forward Euler
+// would need the same Newton solve on the AE rows so backward Euler is used instead.
+template<typename T3>
+class compiledDAE {
+public:
+  compiledDAE(const DifferentialAlgebraicEquation<double, double, T3>& DAE, integrationMethod method = integrationMethod::FORWARD_EULER,
+              const std::vector<std::shared_ptr<nonlinearDevice>>& devices = {});
+  compiledDAE(const SparseDifferentialAlgebraicEquation<T3>& DAE, integrationMethod method = integrationMethod::FORWARD_EULER,
+              const std::vector<std::shared_ptr<nonlinearDevice>>& devices = {});
+
+  // yn1 = the state at tn + timeStep, both vectors have size() entries
+  void step(double tn, double timeStep, const std::vector<double>& yn, std::vector<double>& yn1);
+  // Forget the previous step, the next step will be backward Euler
+  void reset() { hasHistory = false; hasLastSource = false; lastStep = 0.0; };
+  std::pair<std::vector<double>, std::vector<matrix<double>>> solve(const matrix<double>& initalGuess, double timeStep, double timeEnd);
+  // The output is still on the timeStep grid, the steps taken in between are picked
+  // so that the local truncation error stays within tolerance times the signal size
+  std::pair<std::vector<double>, std::vector<matrix<double>>> solveAdaptive(const matrix<double>& initalGuess, double timeStep, double timeEnd, double tolerance, double maxStep);
+  // The same but each output point goes to sink instead of being kept
+  void solve(const matrix<double>& initalGuess, double timeStep, double timeEnd, resultSink& sink);
+  void solveAdaptive(const matrix<double>& initalGuess, double timeStep, double timeEnd, double tolerance, double maxStep, resultSink& sink);
+  int acceptedSteps = 0;
+  int rejectedSteps = 0;
+  // Steps where Newton did not converge, the last iterate is used
+  int newtonFailures = 0;
+  // A matrix the steps need could not be factored, step() does nothing and solve() stops
+  bool isSingular = false;
+  const newtonSolver& getNewton() const { return newton; };
+
+  int size() const { return n; };
+  integrationMethod getMethod() const { return method; };
+  bool useSparse = false;
+
+private:
+  integrationMethod method = integrationMethod::FORWARD_EULER;
+  int n = 0;
+  std::vector<int> DEIdx, DEColIdx, AEIdx, AEColIdx;
+  // ADE is the DE rows with all cols, AAE is the AE rows with only the DE cols
+  sparseMatrix<double> ADE, AAE;
+  sparseLU EDESparseLU, AnSparseLU;
+  denseLU<double> EDEDenseLU, AnDenseLU;
+  std::vector<compiledFunction> fDE, fAE;
+  std::vector<double> xDE, xAE;
+
+  // Used by the implicit methods
+  sparseMatrix<double> A, E;
+  std::vector<compiledFunction> f;
+  std::vector<bool> isDERow;
+  sparseLU implicitSparseLU;
+  denseLU<double> implicitDenseLU;
+  newtonSolver newton; // only used if there are nonlinear devices
+  bool hasDevices = false;
+  double factoredScale = 0.0; // the a/h that the implicit matrix was factored with
+  std::vector<double> rhs, ynm1, fLast, deviceCurrents;
+  double lastStep = 0.0;
+  double fLastTime = 0.0;
+  bool hasHistory = false;
+  bool hasLastSource = false;
+
+  void compile(const sparseMatrix<double>& A, const sparseMatrix<double>& E, const matrix<T3>& f);
+  void solveDE(std::vector<double>& x) const;
+  void solveAE(std::vector<double>& x) const;
+  void forwardEulerStep(double tn, double timeStep, const std::vector<double>& yn, std::vector<double>& yn1);
+  void implicitStep(double tn, double timeStep, const std::vector<double>& yn, std::vector<double>& yn1);
+  void acceptStep(const std::vector<double>& yn, double timeStep);
+  void factorImplicit(double scale);
+  double stepToSmoothSources(double t, double h, const std::vector<double>& yn, const std::vector<double>& yn1,
+                             double timeStep, int outIdx, double tolerance, double& worst) const;
+  static double evaluateSource(const compiledFunction& source, double t) { return source.evaluate(t); };
+};
+
+template<typename T3>
+compiledDAE<T3>::compiledDAE(const DifferentialAlgebraicEquation<double, double, T3>& DAE, integrationMethod method,
+                             const std::vector<std::shared_ptr<nonlinearDevice>>& devices)
+  : method(method), newton(devices, false), hasDevices(!devices.empty()) {
+  useSparse = false;
+  if (hasDevices && method == integrationMethod::FORWARD_EULER) {
+    this->method = integrationMethod::BACKWARD_EULER;
+  }
+  compile(createSparseFromDense(DAE.A), createSparseFromDense(DAE.E), DAE.f);
+}
+
+template<typename T3>
+compiledDAE<T3>::compiledDAE(const SparseDifferentialAlgebraicEquation<T3>& DAE, integrationMethod method,
+                             const std::vector<std::shared_ptr<nonlinearDevice>>& devices)
+  : method(method), newton(devices, true), hasDevices(!devices.empty()) {
+  useSparse = true;
+  if (hasDevices && method == integrationMethod::FORWARD_EULER) {
+    this->method = integrationMethod::BACKWARD_EULER;
+  }
+  compile(DAE.A, DAE.E, DAE.f);
+}
+
+template<typename T3>
+void compiledDAE<T3>::compile(const sparseMatrix<double>& AIn, const sparseMatrix<double>& EIn, const matrix<T3>& fIn) {
+  A = AIn;
+  E = EIn;
+  n = A.rows;
+  DEIdx = E.nonEmptyRows();
+  DEColIdx = E.nonEmptyCols();
+  isDERow = std::vector<bool>(n, false);
+  std::vector<bool> isDECol(n, false);
+  for (auto row : DEIdx) isDERow[row] = true;
+  for (auto col : DEColIdx) isDECol[col] = true;
+  AEIdx.clear();
+  AEColIdx.clear();
+  for (int i = 0; i < n; i++) {
+    if (!isDERow[i]) AEIdx.push_back(i);
+    if (!isDECol[i]) AEColIdx.push_back(i);
+  }
+
+  f.clear();
+  for (int row = 0; row < n; row++) f.push_back(compiledFunction(fIn[row][0]));
+  rhs = std::vector<double>(n);
+  factoredScale = 0.0;
+  hasHistory = false;
+  hasLastSource = false;
+  isSingular = false;
+  if (method != integrationMethod::FORWARD_EULER) {
+    return;
+  }
+
+  ADE = A.getSubMatrix(DEIdx, createIdxRange(n));
+  AAE = A.getSubMatrix(AEIdx, DEColIdx);
+  auto EDE = E.getSubMatrix(DEIdx, DEColIdx);
+  auto An = A.getSubMatrix(AEIdx, AEColIdx);
+  if (useSparse) {
+    EDESparseLU.factor(EDE);
+    AnSparseLU.factor(An);
+    isSingular = EDESparseLU.isSingular || AnSparseLU.isSingular;
+  } else {
+    EDEDenseLU.factor(EDE.toDense());
+    AnDenseLU.factor(An.toDense());
+    isSingular = EDEDenseLU.isSingular || AnDenseLU.isSingular;
+  }
+
+  fDE.clear();
+  fAE.clear();
+  for (auto row : DEIdx) fDE.push_back(f[row]);
+  for (auto row : AEIdx) fAE.push_back(f[row]);
+  xDE = std::vector<double>(DEIdx.size());
+  xAE = std::vector<double>(AEIdx.size());
+}
+
+template<typename T3>
+void compiledDAE<T3>::solveDE(std::vector<double>& x) const {
+  if (x.size() == 0) return;
+  if (useSparse) {
+    EDESparseLU.solveInPlace(x);
+  } else {
+    EDEDenseLU.solveInPlace(x);
+  }
+}
+
+template<typename T3>
+void compiledDAE<T3>::solveAE(std::vector<double>& x) const {
+  if (x.size() == 0) return;
+  if (useSparse) {
+    AnSparseLU.solveInPlace(x);
+  } else {
+    AnDenseLU.solveInPlace(x);
+  }
+}
+
+template<typename T3>
+void compiledDAE<T3>::step(double tn, double timeStep, const std::vector<double>& yn, std::vector<double>& yn1) {
+  if (isSingular) {
+    return;
+  }
+  if (method == integrationMethod::FORWARD_EULER) {
+    forwardEulerStep(tn, timeStep, yn, yn1);
+  } else {
+    implicitStep(tn, timeStep, yn, yn1);
+    acceptStep(yn, timeStep);
+  }
+}
+
+// Forward Euler on the DE rows, then the AE rows are solved with the new DE values
+template<typename T3>
+void compiledDAE<T3>::forwardEulerStep(double tn, double timeStep, const std::vector<double>& yn, std::vector<double>& yn1) {
+  // E xDE' = f - A yn
+  for (int i = 0; i < (int)DEIdx.size(); i++) {
+    double sum = evaluateSource(fDE[i], tn);
+    for (int p = ADE.rowStart[i]; p < ADE.rowStart[i + 1]; p++) {
+      sum -= ADE.values[p] * yn[ADE.colIdx[p]];
+    }
+    xDE[i] = sum;
+  }
+  solveDE(xDE);
+  for (int i = 0; i < (int)DEColIdx.size(); i++) {
+    xDE[i] = yn[DEColIdx[i]] + timeStep * xDE[i];
+  }
+
+  // An xAE = f - AAE xDE
+  for (int i = 0; i < (int)AEIdx.size(); i++) {
+    double sum = evaluateSource(fAE[i], tn);
+    for (int p = AAE.rowStart[i]; p < AAE.rowStart[i + 1]; p++) {
+      sum -= AAE.values[p] * xDE[AAE.colIdx[p]];
+    }
+    xAE[i] = sum;
+  }
+  solveAE(xAE);
+
+  for (int i = 0; i < (int)DEColIdx.size(); i++) {
+    yn1[DEColIdx[i]] = xDE[i];
+  }
+  for (int i = 0; i < (int)AEColIdx.size(); i++) {
+    yn1[AEColIdx[i]] = xAE[i];
+  }
+}
+
+// M = A + scale E
+template<typename T3>
+void compiledDAE<T3>::factorImplicit(double scale) {
+  if (scale == factoredScale) {
+    return;
+  }
+  sparseMatrix<double> M;
+  M.rows = n;
+  M.cols = n;
+  M.createData();
+  for (int row = 0; row < n; row++) {
+    for (int p = A.rowStart[row]; p < A.rowStart[row + 1]; p++) {
+      M.at(row, A.colIdx[p]) += A.values[p];
+    }
+    for (int p = E.rowStart[row]; p < E.rowStart[row + 1]; p++) {
+      M.at(row, E.colIdx[p]) += scale * E.values[p];
+    }
+  }
+  M.compress();
+  if (hasDevices) {
+    newton.setLinear(M);
+  } else if (useSparse) {
+    implicitSparseLU.factor(M);
+    isSingular = implicitSparseLU.isSingular;
+  } else {
+    implicitDenseLU.factor(M.toDense());
+    isSingular = implicitDenseLU.isSingular;
+  }
+  factoredScale = scale;
+}
+
+// The sources are evaluated at the end of the step, tn + timeStep.
+// Trapezoidal is only used on the DE rows, the AE rows are still enforced
+// exactly at the end of the step so the algebraic unknowns do not ring.
+// This does not move the history on, that is done by acceptStep() so a
+// step can be thrown away and tried again with a smaller timeStep.
+template<typename T3>
+void compiledDAE<T3>::implicitStep(double tn, double timeStep, const std::vector<double>& yn, std::vector<double>& yn1) {
+  // The first step is backward Euler, BDF2 needs two old points and the
+  // initial state is usually not consistent, which trapezoidal would not damp
+  auto stepMethod = method;
+  if (!hasHistory) {
+    stepMethod = integrationMethod::BACKWARD_EULER;
+  }
+  // BDF2 with a changing step, w is the ratio to the last step and
+  // x' = (a x(n+1) - (1 + w) x(n) + w^2/(1 + w) x(n-1))/h, a = 3/2 when w = 1
+  double w = (lastStep > 0.0) ? timeStep / lastStep : 1.0;
+  double a = 1.0;
+  if (stepMethod == integrationMethod::TRAPEZOIDAL) {
+    a = 2.0;
+  } else if (stepMethod == integrationMethod::BDF2) {
+    a = (1.0 + 2.0 * w) / (1.0 + w);
+  }
+  factorImplicit(a / timeStep);
+  if (isSingular) {
+    return;
+  }
+
+  double tn1 = tn + timeStep;
+  bool useLastSource = hasLastSource && fLastTime == tn;
+  if (stepMethod == integrationMethod::TRAPEZOIDAL && !useLastSource) {
+    fLast = std::vector<double>(n);
+    for (int row = 0; row < n; row++) {
+      fLast[row] = evaluateSource(f[row], tn);
+    }
+  }
+
+  // The trapezoidal rule averages M x + i(x) over the step, so the DE rows need the device currents at yn too
+  if (stepMethod == integrationMethod::TRAPEZOIDAL && hasDevices) {
+    deviceCurrents.assign(n, 0.0);
+    for (auto& device : newton.devices) {
+      device->addCurrents(yn, deviceCurrents);
+    }
+  }
+
+  for (int row = 0; row < n; row++) {
+    double fn1 = evaluateSource(f[row], tn1);
+    double sum = fn1;
+    for (int p = E.rowStart[row]; p < E.rowStart[row + 1]; p++) {
+      int col = E.colIdx[p];
+      if (stepMethod == integrationMethod::BDF2) {
+        sum += E.values[p] / timeStep * ((1.0 + w) * yn[col] - w * w / (1.0 + w) * ynm1[col]);
+      } else {
+        sum += a / timeStep * E.values[p] * yn[col];
+      }
+    }
+    if (stepMethod == integrationMethod::TRAPEZOIDAL && isDERow[row]) {
+      sum += fLast[row];
+      for (int p = A.rowStart[row]; p < A.rowStart[row + 1]; p++) {
+        sum -= A.values[p] * yn[A.colIdx[p]];
+      }
+      if (hasDevices) {
+        sum -= deviceCurrents[row];
+      }
+    }
+    rhs[row] = sum;
+    if (stepMethod == integrationMethod::TRAPEZOIDAL) {
+      // Saved for the start of the next step, fLast[row] has already been used
+      fLast[row] = fn1;
+    }
+  }
+  if (stepMethod == integrationMethod::TRAPEZOIDAL) {
+    fLastTime = tn1;
+    hasLastSource = true;
+  }
+
+  if (hasDevices) {
+    yn1 = yn;
+    if (!newton.solve(rhs, yn1)) {
+      newtonFailures++;
+    }
+    return;
+  }
+  if (useSparse) {
+    implicitSparseLU.solveInPlace(rhs);
+  } else {
+    implicitDenseLU.solveInPlace(rhs);
+  }
+  for (int row = 0; row < n; row++) {
+    yn1[row] = rhs[row];
+  }
+}
+
+template<typename T3>
+void compiledDAE<T3>::acceptStep(const std::vector<double>& yn, double timeStep) {
+  ynm1 = yn;
+  lastStep = timeStep;
+  hasHistory = true;
+}
+
+// Same interface and output layout as DAESolve2
+template<typename T3>
+std::pair<std::vector<double>, std::vector<matrix<double>>> compiledDAE<T3>::solve(const matrix<double>& initalGuess, double timeStep, double timeEnd) {
+  columnStoreSink store;
+  solve(initalGuess, timeStep, timeEnd, store);
+  return store.take();
+}
+
+template<typename T3>
+void compiledDAE<T3>::solve(const matrix<double>& initalGuess, double timeStep, double timeEnd, resultSink& sink) {
+  int steps = ceil(timeEnd/timeStep);
+  sink.begin(n, steps);
+
+  std::vector<double> yn(initalGuess.data.begin(), initalGuess.data.begin() + n);
+  std::vector<double> yn1(n);
+  reset();
+  for (int i = 0; i < steps; i++) {
+    double tn = i * timeStep - timeStep;
+    // Forward Euler solves the AE rows with the sources at tn, the implicit
+    // methods solve everything at the end of the step, so they step to tn
+    if (method == integrationMethod::FORWARD_EULER) {
+      step(tn, timeStep, yn, yn1);
+    } else {
+      step(tn - timeStep, timeStep, yn, yn1);
+    }
+    if (isSingular) {
+      std::cerr << "ERROR: The circuit matrix is singular, the time steps stop at t = " << tn << std::endl;
+      break;
+    }
+    sink.add(tn, yn1);
+    std::swap(yn, yn1);
+  }
+  sink.end();
+}
+
+// The error is estimated by comparing the implicit solution with a polynomial
+// extrapolated through the last accepted points (order 1 for BE, 2 for TRAP and BDF2).
+// If the method has an error of C h^(k+1) x^(k+1) and the extrapolation P x^(k+1)
+// then LTE = C h^(k+1)/(C h^(k+1) + P) (corrector - predictor).
+// Only the unknowns in E (capacitor voltages, inductor currents) have a truncation
+// error, the algebraic unknowns can jump with the sources so they are only checked
+// while the step is longer than the output spacing. Below that the steps land on
+// the output times. A step that is longer is also cut back if the output points it
+// interpolates do not satisfy the AE rows (see stepToSmoothSources()), so a square
+// wave edge is stepped over one output spacing, the same way as with solve().
+// Forward Euler has no cheap estimate like this so TRAP is used instead.
+template<typename T3>
+std::pair<std::vector<double>, std::vector<matrix<double>>> compiledDAE<T3>::solveAdaptive(const matrix<double>& initalGuess, double timeStep, double timeEnd, double tolerance, double maxStep) {
+  columnStoreSink store;
+  solveAdaptive(initalGuess, timeStep, timeEnd, tolerance, maxStep, store);
+  return store.take();
+}
+
+// The output points inside a step are interpolated between yn and yn1, which is only right
+// for the algebraic unknowns while the sources are smooth over the step. Each point is put
+// back into the AE rows with the sources at its own time and if a row is out by more than
+// tolerance times the size of its terms the step is too long. The step to take instead ends
+// on the last output point before that one, or on that point if it is the first in the step.
+// 0 if every output point inside the step is fine. worst is the largest residual over the
+// points that were checked, as a fraction of what is allowed
+template<typename T3>
+double compiledDAE<T3>::stepToSmoothSources(double t, double h, const std::vector<double>& yn, const std::vector<double>& yn1,
+                                            double timeStep, int outIdx, double tolerance, double& worst) const {
+  double minStep = timeStep * 1e-6;
+  worst = 0.0;
+  std::vector<double> point(n), currents(n);
+  for (int k = outIdx; ; k++) {
+    double tOut = k * timeStep - timeStep;
+    if (tOut >= t + h - minStep) {
+      return 0.0;
+    }
+    if (tOut <= t + minStep) {
+      continue;
+    }
+    double fraction = (tOut - t) / h;
+    for (int row = 0; row < n; row++) {
+      point[row] = yn[row] + fraction * (yn1[row] - yn[row]);
+    }
+    if (hasDevices) {
+      std::fill(currents.begin(), currents.end(), 0.0);
+      for (auto& device : newton.devices) {
+        device->addCurrents(point, currents);
+      }
+    }
+    for (auto row : AEIdx) {
+      double source = evaluateSource(f[row], tOut);
+      double residual = source - currents[row];
+      double size = std::abs(source) + std::abs(currents[row]);
+      for (int p = A.rowStart[row]; p < A.rowStart[row + 1]; p++) {
+        double term = A.values[p] * point[A.colIdx[p]];
+        residual -= term;
+        size += std::abs(term);
+      }
+      worst = std::max(worst, std::abs(residual) / (tolerance * std::max(size, 1e-6)));
+      if (worst > 1.0) {
+        double previous = tOut - timeStep;
+        return (previous > t + minStep) ? previous - t : tOut - t;
+      }
+    }
+  }
+}
+
+template<typename T3>
+void compiledDAE<T3>::solveAdaptive(const matrix<double>& initalGuess, double timeStep, double timeEnd, double tolerance, double maxStep, resultSink& sink) {
+  if (method == integrationMethod::FORWARD_EULER) {
+    method = integrationMethod::TRAPEZOIDAL;
+  }
+  int order = (method == integrationMethod::BACKWARD_EULER) ? 1 : 2;
+  double C = 0.5;
+  if (method == integrationMethod::TRAPEZOIDAL) {
+    C = -1.0 / 12.0;
+  } else if (method == integrationMethod::BDF2) {
+    C = -2.0 / 9.0;
+  }
+  std::vector<bool> isDECol(n, false);
+  for (auto col : DEColIdx) isDECol[col] = true;
+
+  int steps = ceil(timeEnd/timeStep);
+  sink.begin(n, steps);
+  std::vector<double> point(n);
+  if (maxStep <= 0.0) {
+    maxStep = timeEnd;
+  }
+  double minStep = timeStep * 1e-6;
+
+  // The output times are the same as solve(), the initial state is one step before the first
+  double t = -2.0 * timeStep;
+  std::vector<double> yn(initalGuess.data.begin(), initalGuess.data.begin() + n);
+  std::vector<double> yn1(n), peak(n, 0.0);
+  // Accepted points before yn, newest first
+  std::vector<std::vector<double>> history;
+  std::vector<double> historyTime;
+
+  reset();
+  acceptedSteps = 0;
+  rejectedSteps = 0;
+  bool warnedMinStep = false;
+  double hWanted = std::min(timeStep, maxStep);
+  double smoothLimit = maxStep;
+  int outIdx = 0;
+  while (outIdx < steps) {
+    double toNextOutput = (outIdx * timeStep - timeStep) - t;
+    // Land on the next output time, this only ever shortens the step so a
+    // rejected step is always tried again with a smaller one
+    double h = hWanted;
+    if (h <= timeStep && toNextOutput > minStep) {
+      if (toNextOutput <= h) {
+        h = toNextOutput;
+      } else if (toNextOutput < 2.0 * h) {
+        h = toNextOutput / 2.0;
+      }
+    }
+    implicitStep(t, h, yn, yn1);
+    if (isSingular) {
+      std::cerr << "ERROR: The circuit matrix is singular, the time steps stop at t = " << t << std::endl;
+      break;
+    }
+
+    double errorDE = 0.0, errorAE = 0.0;
+    bool canEstimate = (int)history.size() >= order;
+    if (canEstimate) {
+      double h1 = t - historyTime[0];
+      double h2 = (order == 2) ? historyTime[0] - historyTime[1] : 0.0;
+      double P, Ch;
+      if (order == 1) {
+        P = h * (h + h1) / 2.0;
+        Ch = C * h * h;
+      } else {
+        P = h * (h + h1) * (h + h1 + h2) / 6.0;
+        Ch = C * h * h * h;
+      }
+      double ratio = std::abs(Ch / (Ch + P));
+      for (int row = 0; row < n; row++) {
+        // Newton form of the extrapolating polynomial
+        double d1 = (yn[row] - history[0][row]) / h1;
+        double predictor = yn[row] + d1 * h;
+        if (order == 2) {
+          double d1Old = (history[0][row] - history[1][row]) / h2;
+          double d2 = (d1 - d1Old) / (h1 + h2);
+          predictor += d2 * h * (h + h1);
+        }
+        double scale = tolerance * std::max({peak[row], std::abs(yn1[row]), 1e-6});
+        double error = ratio * std::abs(yn1[row] - predictor) / scale;
+        if (isDECol[row]) {
+          errorDE = std::max(errorDE, error);
+        } else {
+          errorAE = std::max(errorAE, error);
+        }
+      }
+    }
+    double error = errorDE;
+    if (h > timeStep * (1.0 + 1e-9)) {
+      error = std::max(error, errorAE);
+    }
+
+    // The interpolation error of the algebraic unknowns goes with h^2, the longest step it
+    // allows is kept so the step does not grow back into the same cut every time.
+    // Steps up to timeStep are not interpolated so it is never below that
+    double smoothness;
+    double smoothStep = stepToSmoothSources(t, h, yn, yn1, timeStep, outIdx, tolerance, smoothness);
+    if (smoothness > 0.0) {
+      smoothLimit = std::max(timeStep, h * 0.9 / std::sqrt(smoothness));
+    }
+
+    double factor = (error > 0.0) ? 0.9 * std::pow(error, -1.0 / (order + 1)) : 2.0;
+    factor = std::clamp(factor, 0.25, 2.0);
+    if (canEstimate && error > 1.0 && h > minStep) {
+      rejectedSteps++;
+      hWanted = std::max(h * factor, minStep);
+      continue;
+    }
+    if (smoothStep > 0.0) {
+      // A smooth source only needs the shorter step, a jump needs the cut
+      rejectedSteps++;
+      hWanted = std::max(smoothStep, smoothLimit);
+      continue;
+    }
+    if (error > 1.0 && !warnedMinStep) {
+      std::cerr << "ERROR: Time step is at the minimum of " << minStep << " at t = " << t << ", the tolerance is not being met" << std::endl;
+      warnedMinStep = true;
+    }
+
+    // Fill in the output points that are now covered
+    double tn1 = t + h;
+    while (outIdx < steps) {
+      double tOut = outIdx * timeStep - timeStep;
+      if (tOut > tn1 + minStep) {
+        break;
+      }
+      double fraction = std::min((tOut - t) / h, 1.0);
+      for (int row = 0; row < n; row++) {
+        point[row] = yn[row] + fraction * (yn1[row] - yn[row]);
+      }
+      sink.add(tOut, point);
+      outIdx++;
+    }
+
+    acceptStep(yn, h);
+    acceptedSteps++;
+    history.insert(history.begin(), yn);
+    historyTime.insert(historyTime.begin(), t);
+    if ((int)history.size() > 2) {
+      history.pop_back();
+      historyTime.pop_back();
+    }
+    for (int row = 0; row < n; row++) {
+      peak[row] = std::max(peak[row], std::abs(yn1[row]));
+    }
+    std::swap(yn, yn1);
+    t = tn1;
+
+    // Only change the step if it is worth refactoring for
+    if (canEstimate && (factor < 1.0 || factor > 1.2)) {
+      hWanted = std::max(hWanted, h) * factor;
+    }
+    if (smoothness == 0.0) {
+      smoothLimit *= 1.2;
+    }
+    hWanted = std::clamp(std::min(hWanted, smoothLimit), minStep, maxStep);
+  }
+  sink.end();
+}
@@ -0,0 +1,191 @@
+#include "compiledFunction.h"
+
+compiledFunction::compiledFunction(double value)
+  : constant(true), value(value) {
+  instructions.push_back({instruction::PUSH_CONSTANT, value});
+  stackSize = 1;
+}
+
+compiledFunction::compiledFunction(const function& f) {
+  std::vector<stackEntry> stack;
+  compile(f, stack);
+  constant = stack.back().isConstant;
+  value = stack.back().value;
+}
+
+void compiledFunction::pushConstant(double value, int start, std::vector<stackEntry>& stack) {
+  instructions.resize(start);
+  instructions.push_back({instruction::PUSH_CONSTANT, value});
+  stack.push_back({true, value, start});
+  stackSize = std::max(stackSize, (int)stack.size());
+}
+
+// Unknown operations are left alone as they might do more than return a value
+bool compiledFunction::onlyKnown(int start) const {
+  for (int i = start; i < (int)instructions.size(); i++) {
+    if (instructions[i].type == instruction::CALL || instructions[i].type == instruction::CALL_BRANCH) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void compiledFunction::compile(const function& f, std::vector<stackEntry>& stack) {
+  if (f.isBranch && f.brachOperation != nullptr) {
+    compile(*f.functions.first, stack);
+    compile(*f.functions.second, stack);
+    applyBranch(f.brachOperation, stack);
+  } else {
+    stack.push_back({false, 0.0, (int)instructions.size()});
+    stackSize = std::max(stackSize, (int)stack.size());
+    instructions.push_back({instruction::PUSH_TIME});
+  }
+  for (auto& op : f.operations) {
+    applyOperation(op, stack);
+  }
+}
+
+void compiledFunction::applyOperation(const operationPtr& op, std::vector<stackEntry>& stack) {
+  stackEntry top = stack.back();
+  auto known = op.target<operation>();
+  if (known == nullptr) {
+    // Called on every evaluate even with a constant input, the top is not known after it
+    calls.push_back(op);
+    instructions.push_back({instruction::CALL, 0.0, 0.0, 0.0, (int)calls.size() - 1});
+    stack.back().isConstant = false;
+    return;
+  }
+  if (top.isConstant) {
+    stack.pop_back();
+    pushConstant((*known)(top.value), top.start, stack);
+    return;
+  }
+  switch (known->type) {
+  case operation::CONSTANT:
+  case operation::COS: {
+    // Neither of these use their input
+    stack.pop_back();
+    pushConstant((*known)(0.0), top.start, stack);
+    break;
+  }
+  case operation::ADD: {
+    instructions.push_back({instruction::ADD_CONSTANT, known->a});
+    break;
+  }
+  case operation::MULTIPLY: {
+    // x 0 is 0 whatever x is, so a DC source (t 0 + V) ends up as one constant
+    if (known->a == 0.0 && onlyKnown(top.start)) {
+      stack.pop_back();
+      pushConstant(0.0, top.start, stack);
+      break;
+    }
+    instructions.push_back({instruction::MULTIPLY_CONSTANT, known->a});
+    break;
+  }
+  case operation::DIVIDE: {
+    instructions.push_back({instruction::DIVIDE_CONSTANT, known->a});
+    break;
+  }
+  case operation::SIN: {
+    instructions.push_back({instruction::SIN, known->a, known->b*2*M_PI, known->c});
+    break;
+  }
+  case operation::SCALE_TO_ONE: {
+    instructions.push_back({instruction::SCALE_TO_ONE});
+    break;
+  }
+  }
+}
+
+void compiledFunction::applyBranch(const branchPtr& op, std::vector<stackEntry>& stack) {
+  stackEntry right = stack.back();
+  stack.pop_back();
+  stackEntry left = stack.back();
+  stack.pop_back();
+
+  instruction::code withConstant = instruction::CALL_BRANCH;
+  instruction::code withStack = instruction::CALL_BRANCH;
+  double identity = 0.0;
+  bool commutes = false;
+  auto known = op.target<double(*)(double, double)>();
+  if (known != nullptr && *known == branchOperation::add) {
+    withConstant = instruction::ADD_CONSTANT;
+    withStack = instruction::ADD;
+    identity = 0.0;
+    commutes = true;
+  } else if (known != nullptr && *known == branchOperation::multiply) {
+    withConstant = instruction::MULTIPLY_CONSTANT;
+    withStack = instruction::MULTIPLY;
+    identity = 1.0;
+    commutes = true;
+  } else if (known != nullptr && *known == branchOperation::divide) {
+    withConstant = instruction::DIVIDE_CONSTANT;
+    withStack = instruction::DIVIDE;
+    identity = 1.0;
+  }
+
+  // Only the known branches are folded, the others are called on every evaluate
+  if (withStack != instruction::CALL_BRANCH && left.isConstant && right.isConstant) {
+    pushConstant(op(left.value, right.value), left.start, stack);
+    return;
+  }
+
+  // Multiplying by a constant 0 throws the other side away
+  if (withStack == instruction::MULTIPLY && ((right.isConstant && right.value == 0.0 && onlyKnown(left.start)) ||
+                                             (left.isConstant && left.value == 0.0 && onlyKnown(right.start)))) {
+    pushConstant(0.0, left.start, stack);
+    return;
+  }
+
+  // One side is a constant, drop its PUSH_CONSTANT and use the constant form
+  if (withConstant != instruction::CALL_BRANCH && (right.isConstant || (left.isConstant && commutes))) {
+    double constantValue;
+    if (right.isConstant) {
+      constantValue = right.value;
+      instructions.resize(right.start);
+    } else {
+      constantValue = left.value;
+      instructions.erase(instructions.begin() + left.start);
+    }
+    if (constantValue != identity) {
+      instructions.push_back({withConstant, constantValue});
+    }
+  } else if (withStack != instruction::CALL_BRANCH) {
+    instructions.push_back({withStack});
+  } else {
+    branchCalls.push_back(op);
+    instructions.push_back({instruction::CALL_BRANCH, 0.0, 0.0, 0.0, (int)branchCalls.size() - 1});
+  }
+  stack.push_back({false, 0.0, left.start});
+}
+
+double compiledFunction::evaluate(double t) const {
+  if (constant) {
+    return value;
+  }
+  double local[16] = {};
+  std::vector<double> heap;
+  double* s = local;
+  if (stackSize > 16) {
+    heap.resize(stackSize);
+    s = heap.data();
+  }
+  int top = -1;
+  for (auto& in : instructions) {
+    switch (in.type) {
+    case instruction::PUSH_TIME: s[++top] = t; break;
+    case instruction::PUSH_CONSTANT: s[++top] = in.a; break;
+    case instruction::ADD_CONSTANT: s[top] = in.a + s[top]; break;
+    case instruction::MULTIPLY_CONSTANT: s[top] = in.a * s[top]; break;
+    case instruction::DIVIDE_CONSTANT: s[top] = s[top] / in.a; break;
+    case instruction::SIN: s[top] = in.a*std::sin(in.b*s[top] + in.c); break;
+    case instruction::SCALE_TO_ONE: s[top] = (s[top] > 0) ? 1.0 : ((s[top] < 0) ? -1.0 : 0.0); break;
+    case instruction::ADD: top--; s[top] = s[top] + s[top + 1]; break;
+    case instruction::MULTIPLY: top--; s[top] = s[top] * s[top + 1]; break;
+    case instruction::DIVIDE: top--; s[top] = s[top] / s[top + 1]; break;
+    case instruction::CALL: s[top] = calls[in.index](s[top]); break;
+    case instruction::CALL_BRANCH: top--; s[top] = branchCalls[in.index](s[top], s[top + 1]); break;
+    }
+  }
+  return s[0];
+}
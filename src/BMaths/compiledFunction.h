@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include "function.h"
+
+// A function tree lowered to a flat list of instructions for a small stack machine.
+// Walking a function calls a std::function for every operation and follows a
+// shared_ptr for every branch, this is done once here instead. Anything that does
+// not depend on t is folded into a constant while compiling, so the zero entries
+// of f and sums like 0 + sin(t) cost nothing or one instruction. Anything times
+// a constant 0 is folded to 0 as well, as long as it has no unknown operations in it.
+// Operations that were not made by Operation:: (so have no operation to read
+// back) are still called through their std::function, and never folded, even
+// with a constant input.
+class compiledFunction {
+public:
+  compiledFunction() {};
+  compiledFunction(double value);
+  compiledFunction(const function& f);
+
+  double evaluate(double t) const;
+  bool isConstant() const { return constant; };
+  int size() const { return instructions.size(); };
+
+private:
+  struct instruction {
+    enum code {
+      PUSH_TIME,
+      PUSH_CONSTANT,
+      ADD_CONSTANT,
+      MULTIPLY_CONSTANT,
+      DIVIDE_CONSTANT,
+      SIN,             // a sin(b t + c), b already has the 2 pi in it
+      SCALE_TO_ONE,
+      ADD,
+      MULTIPLY,
+      DIVIDE,
+      CALL,            // unknown operation, calls[index]
+      CALL_BRANCH      // unknown branch operation, branchCalls[index]
+    };
+    code type;
+    double a = 0.0, b = 0.0, c = 0.0;
+    int index = 0;
+  };
+
+  bool constant = true;
+  double value = 0.0;
+  std::vector<instruction> instructions;
+  std::vector<operationPtr> calls;
+  std::vector<branchPtr> branchCalls;
+  int stackSize = 0;
+
+  // What is known about the top of the stack while compiling
+  struct stackEntry {
+    bool isConstant;
+    double value;
+    int start; // the first instruction that makes it
+  };
+  void compile(const function& f, std::vector<stackEntry>& stack);
+  void applyOperation(const operationPtr& op, std::vector<stackEntry>& stack);
+  void applyBranch(const branchPtr& op, std::vector<stackEntry>& stack);
+  void pushConstant(double value, int start, std::vector<stackEntry>& stack);
+  // True if the instructions from start on have no CALL or CALL_BRANCH
+  bool onlyKnown(int start) const;
+};
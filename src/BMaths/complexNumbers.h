@@ -18,6 +18,10 @@ public:
     return atan2(b, a);
   }
 
+  inline complexNumber<T> conjugate() const {
+    return complexNumber(a, -b);
+  }
+
   inline void print() const {
     std::cout << a << " + " << b << "j" << std::endl;
   }
@@ -35,6 +39,24 @@ public:
     return complexNumber(this->a - other.a, this->b - other.b);
   }
 
+  inline complexNumber<T> operator/(const complexNumber<T>& other) const {
+    T denominator = other.a * other.a + other.b * other.b;
+    return complexNumber((this->a * other.a + this->b * other.b) / denominator,
+                         (this->b * other.a - this->a * other.b) / denominator);
+  }
+
+  inline complexNumber<T> operator-() const {
+    return complexNumber(-this->a, -this->b);
+  }
+
+  inline bool operator==(const complexNumber<T>& other) const {
+    return this->a == other.a && this->b == other.b;
+  }
+
+  inline bool operator!=(const complexNumber<T>& other) const {
+    return !(*this == other);
+  }
+
   inline complexNumber<T> operator*(double scalar) const {
     return complexNumber<T>(this->a * scalar, this->b * scalar);
   }
@@ -88,6 +110,12 @@ public:
   }
 };
 
+// So templates can use abs() on both doubles and complex numbers
+template<typename T>
+double abs(const complexNumber<T>& c) {
+  return c.magnitude();
+}
+
 template<typename T>
 complexNumber<T> makeComplexNumberFromPolar(double r, double phi) {
   return complexNumber<T>(r*cos(phi), r*sin(phi));
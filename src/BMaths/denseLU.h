@@ -0,0 +1,188 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include "matrix.h"
+#include "vectorKernels.h"
+#include "blockedKernels.h"
+#include "fixedMatrix.h"
+#include "complexNumbers.h"
+
+// Dense LU factorization with partial pivoting, P A = L U.
+// Factor once and then reuse the factors for every solve, this replaces calling
+// matrix::invert() in the time loop.
+// T can also be complexNumber<double>, this is used by the AC sweep.
+// Real systems up to maxFixedSize are factored and solved by a fixedLU of that size.
+template <typename T>
+class denseLU {
+public:
+  denseLU() {};
+  denseLU(const matrix<T>& A) { factor(A); };
+
+  // M can be a matrix or one of the views
+  template <typename M>
+  void factor(const M& A);
+  matrix<T> solve(const matrix<T>& b) const;
+  void solveInPlace(std::vector<T>& x) const;
+
+  bool isFactored = false;
+  bool isSingular = false;
+  int n = 0;
+
+private:
+  std::vector<T> LU; // row major, L has a unit diagonal that is not stored
+  std::vector<int> perm; // row i of L U is row perm[i] of A
+  std::shared_ptr<smallDenseLU> small; // only for small real systems, LU and perm are not used then
+};
+
+template <typename T>
+template <typename M>
+void denseLU<T>::factor(const M& A) {
+  if (A.rows != A.cols) {
+    std::cerr << "ERROR: LU needs a square matrix" << std::endl;
+    return;
+  }
+  using std::abs;
+  n = A.rows;
+  isFactored = false;
+  isSingular = false;
+  LU = std::vector<T>(n * n);
+  perm = std::vector<int>(n);
+  for (int row = 0; row < n; row++) {
+    perm[row] = row;
+    for (int col = 0; col < n; col++) {
+      LU[row * n + col] = A(row, col);
+    }
+  }
+  small.reset();
+
+  if constexpr (std::is_same<T, double>::value) {
+    if (n >= 1 && n <= maxFixedSize) {
+      small = createFixedLU(n);
+      if (!small->factor(LU.data())) {
+        std::cerr << "ERROR: matrix is singular" << std::endl;
+        isSingular = true;
+        small.reset();
+        return;
+      }
+      isFactored = true;
+      return;
+    }
+    if (!blockedLU(LU.data(), n, perm.data())) {
+      std::cerr << "ERROR: matrix is singular" << std::endl;
+      isSingular = true;
+      return;
+    }
+    isFactored = true;
+    return;
+  }
+
+  for (int k = 0; k < n; k++) {
+    // Search for maximum in this column
+    int maxRow = k;
+    double maxEl = abs(LU[k * n + k]);
+    for (int row = k + 1; row < n; row++) {
+      if (abs(LU[row * n + k]) > maxEl) {
+        maxEl = abs(LU[row * n + k]);
+        maxRow = row;
+      }
+    }
+    if (maxEl == 0.0) {
+      std::cerr << "ERROR: matrix is singular" << std::endl;
+      isSingular = true;
+      return;
+    }
+    if (maxRow != k) {
+      std::swap(perm[k], perm[maxRow]);
+      for (int col = 0; col < n; col++) {
+        std::swap(LU[k * n + col], LU[maxRow * n + col]);
+      }
+    }
+
+    T pivot = LU[k * n + k];
+    for (int row = k + 1; row < n; row++) {
+      T factor = LU[row * n + k] / pivot;
+      LU[row * n + k] = factor;
+      if (factor == T(0.0)) {
+        continue;
+      }
+      if constexpr (std::is_same<T, double>::value) {
+        axpy(-factor, &LU[k * n + k + 1], &LU[row * n + k + 1], n - k - 1);
+        continue;
+      }
+      for (int col = k + 1; col < n; col++) {
+        LU[row * n + col] -= factor * LU[k * n + col];
+      }
+    }
+  }
+  isFactored = true;
+}
+
+template <typename T>
+void denseLU<T>::solveInPlace(std::vector<T>& x) const {
+  if (!isFactored) {
+    std::cerr << "ERROR: LU has not been factored" << std::endl;
+    return;
+  }
+  if constexpr (std::is_same<T, double>::value) {
+    if (small) {
+      small->solveInPlace(x.data());
+      return;
+    }
+  }
+  std::vector<T> y(n);
+  for (int row = 0; row < n; row++) {
+    y[row] = x[perm[row]];
+  }
+  // Forward substitution, L y = P b
+  for (int row = 0; row < n; row++) {
+    if constexpr (std::is_same<T, double>::value) {
+      y[row] -= dot(&LU[row * n], y.data(), row);
+      continue;
+    }
+    T sum = y[row];
+    for (int col = 0; col < row; col++) {
+      sum -= LU[row * n + col] * y[col];
+    }
+    y[row] = sum;
+  }
+  // Back substitution, U x = y
+  for (int row = n - 1; row >= 0; row--) {
+    if constexpr (std::is_same<T, double>::value) {
+      y[row] = (y[row] - dot(&LU[row * n + row + 1], &y[row + 1], n - row - 1)) / LU[row * n + row];
+      continue;
+    }
+    T sum = y[row];
+    for (int col = row + 1; col < n; col++) {
+      sum -= LU[row * n + col] * y[col];
+    }
+    y[row] = sum / LU[row * n + row];
+  }
+  x = y;
+}
+
+template <typename T>
+matrix<T> denseLU<T>::solve(const matrix<T>& b) const {
+  matrix<T> output = b;
+  if constexpr (std::is_same<T, double>::value) {
+    if (b.cols > 1 && !small) {
+      if (!isFactored) {
+        std::cerr << "ERROR: LU has not been factored" << std::endl;
+        return output;
+      }
+      blockedLUSolve(LU.data(), perm.data(), n, output.data.data(), b.cols);
+      return output;
+    }
+  }
+  std::vector<T> column(b.rows);
+  for (int col = 0; col < b.cols; col++) {
+    for (int row = 0; row < b.rows; row++) {
+      column[row] = b[row][col];
+    }
+    solveInPlace(column);
+    for (int row = 0; row < b.rows; row++) {
+      output[row][col] = column[row];
+    }
+  }
+  return output;
+}
@@ -12,14 +12,14 @@ matrix<double> EulersMethod(matrix<double> E, matrix<double> A,
     auto equEinvMulA = EinvMulA.getRow(row);
     double equSol1 = 0.0;
     for (int i = 0; i < f.data.size(); i++) {
-      equSol1 += equEinv.data[i][0] * f.data[i][0];
+      equSol1 += equEinv[i][0] * f[i][0];
     }
     double equSol2 = 0.0;
     for (int i = 0; i < f.data.size(); i++) {
-      equSol2 += equEinvMulA.data[i][0] * yn.data[i][0];
+      equSol2 += equEinvMulA[i][0] * yn[i][0];
     }
     double sol = equSol1 - equSol2;
-    double yn1 = h * sol + yn.data[row][0];
+    double yn1 = h * sol + yn[row][0];
 
     yn1Data.push_back({yn1});
   }
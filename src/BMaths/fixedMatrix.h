@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <cmath>
+#include <utility>
+
+// A matrix with its size fixed at compile time, stored row major in a std::array.
+// Small enough ones live on the stack and every loop over them has constant bounds,
+// so the compiler can unroll them completely.
+template <typename T, int Rows, int Cols>
+class fixedMatrix {
+public:
+  static constexpr int rows = Rows;
+  static constexpr int cols = Cols;
+  std::array<T, Rows * Cols> data{};
+
+  inline T& operator()(int row, int col) { return data[row * Cols + col]; };
+  inline const T& operator()(int row, int col) const { return data[row * Cols + col]; };
+  inline T* operator[](int row) { return data.data() + row * Cols; };
+  inline const T* operator[](int row) const { return data.data() + row * Cols; };
+};
+
+// The circuits in Examples/ have fewer than 16 unknowns, up to this size denseLU
+// uses a fixedLU of the exact size instead of its own loops
+const int maxFixedSize = 16;
+
+// So denseLU can hold a fixedLU of any size
+class smallDenseLU {
+public:
+  virtual ~smallDenseLU() = default;
+  // A is row major, false if it is singular
+  virtual bool factor(const double* A) = 0;
+  virtual void solveInPlace(double* x) const = 0;
+};
+
+// P A = L U with partial pivoting, the same steps as denseLU with N known at compile time
+template <int N>
+class fixedLU : public smallDenseLU {
+public:
+  bool factor(const double* A) override {
+    for (int i = 0; i < N * N; i++) {
+      LU.data[i] = A[i];
+    }
+    for (int row = 0; row < N; row++) {
+      perm[row] = row;
+    }
+    for (int k = 0; k < N; k++) {
+      int maxRow = k;
+      double maxEl = std::abs(LU(k, k));
+      for (int row = k + 1; row < N; row++) {
+        if (std::abs(LU(row, k)) > maxEl) {
+          maxEl = std::abs(LU(row, k));
+          maxRow = row;
+        }
+      }
+      if (maxEl == 0.0) {
+        return false;
+      }
+      if (maxRow != k) {
+        std::swap(perm[k], perm[maxRow]);
+        for (int col = 0; col < N; col++) {
+          std::swap(LU(k, col), LU(maxRow, col));
+        }
+      }
+      double pivot = LU(k, k);
+      for (int row = k + 1; row < N; row++) {
+        double factor = LU(row, k) / pivot;
+        LU(row, k) = factor;
+        for (int col = k + 1; col < N; col++) {
+          LU(row, col) -= factor * LU(k, col);
+        }
+      }
+    }
+    return true;
+  };
+
+  void solveInPlace(double* x) const override {
+    std::array<double, N> y;
+    for (int row = 0; row < N; row++) {
+      y[row] = x[perm[row]];
+    }
+    for (int row = 0; row < N; row++) {
+      double sum = y[row];
+      for (int col = 0; col < row; col++) {
+        sum -= LU(row, col) * y[col];
+      }
+      y[row] = sum;
+    }
+    for (int row = N - 1; row >= 0; row--) {
+      double sum = y[row];
+      for (int col = row + 1; col < N; col++) {
+        sum -= LU(row, col) * y[col];
+      }
+      x[row] = sum / LU(row, row);
+      y[row] = x[row];
+    }
+  };
+
+private:
+  fixedMatrix<double, N, N> LU;
+  std::array<int, N> perm;
+};
+
+template <int N>
+std::shared_ptr<smallDenseLU> createFixedLUUpTo(int n) {
+  if (n == N) {
+    return std::make_shared<fixedLU<N>>();
+  }
+  if constexpr (N > 1) {
+    return createFixedLUUpTo<N - 1>(n);
+  }
+  return nullptr;
+}
+
+// A fixedLU of size n, nullptr if n is bigger than maxFixedSize
+inline std::shared_ptr<smallDenseLU> createFixedLU(int n) {
+  return createFixedLUUpTo<maxFixedSize>(n);
+}
@@ -4,11 +4,29 @@
 #include <cmath>
 #include <numbers>
 #include <algorithm>
+#include <map>
+#include <mutex>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// w[k] = e^(-2 pi i k/N) for k < N/2. The tables are made once per size and kept,
+// every pass of an N point FFT uses the same table with a stride
+inline const std::vector<complexNumber<double>>& getTwiddleTable(int N) {
+  static std::map<int, std::vector<complexNumber<double>>> tables;
+  static std::mutex tablesMutex;
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  auto& table = tables[N];
+  if ((int)table.size() != N / 2) {
+    table.resize(N / 2);
+    for (int k = 0; k < N / 2; k++) {
+      table[k] = makeComplexNumberFromPolar<double>(1.0, -2*M_PI*k/N);
+    }
+  }
+  return table;
+}
+
 template<typename T>
 class FourierTransform {
 public:
@@ -23,12 +41,18 @@ public:
   void fft(std::vector<double> time, matrix<T> inputData) {
     
     int N = std::pow(2, (ceil(log2(inputData.cols))))*2;
+    // The data is real so it is packed two samples to a complex number,
+    // z[n] = x[2n] + i x[2n + 1], and only an N/2 point FFT is needed
     transformData.rows = 1;
-    transformData.cols = N;
+    transformData.cols = N/2;
     transformData.createData();
     for (int col = 0; col < inputData.cols; col++) {
       double window_value = 0.5*(1 - cos(2*M_PI*col/(N - 1)));
-      transformData.data[0][col] = complexNumber<double>(inputData.data[0][col], 0.0) * window_value;
+      if (col % 2 == 0) {
+        transformData[0][col/2].a = inputData[0][col] * window_value;
+      } else {
+        transformData[0][col/2].b = inputData[0][col] * window_value;
+      }
     }
     
     // Need to adjust the fs to be ?larger? due to us adding in data to the next power of two
@@ -38,40 +62,63 @@ public:
     frequency.cols = N/2;
     frequency.createData();
     
-    transformData.data[0] = ditfft2(transformData.data[0], N);
-    transformData.data[0].resize(N/2);
-    transformData.cols = N/2;
+    // transformData is a single row so its buffer is the row
+    realFFTInPlace(transformData.data);
     for (int k = 0; k < N/2; k++) {
-      frequency.data[0][k] = k*fs;
+      frequency[0][k] = k*fs;
     }
   }
   
-  std::vector<complexNumber<double>> ditfft2(std::vector<complexNumber<double>> x, int N) {
-    if (N == 1) {
-      return {x[0]};
-    } 
-
-    auto even = std::vector<complexNumber<T>>(N / 2);
-    auto odd = std::vector<complexNumber<T>>(N / 2);
-
-    for (int i = 0; i < N / 2; i++) {
-      even[i] = x[i*2];
-      odd[i] = x[i*2+1];
+  // Iterative radix-2 FFT, x.size() must be a power of two.
+  // The bit reversal puts x in the order the recursive even/odd split would leave
+  // it, then each pass combines pairs of transforms twice the size of the last,
+  // with the twiddles looked up from the table instead of calling cos and sin.
+  static void fftInPlace(std::vector<complexNumber<double>>& x) {
+    int N = x.size();
+    for (int i = 1, j = 0; i < N; i++) {
+      int bit = N >> 1;
+      for (; j & bit; bit >>= 1) {
+        j ^= bit;
+      }
+      j ^= bit;
+      if (i < j) {
+        std::swap(x[i], x[j]);
+      }
     }
-    even = ditfft2(even, N / 2);
-    odd = ditfft2(odd, N / 2);
-
-    std::vector<complexNumber<T>> X(N);
-    
-    for (int k = 0; k < N / 2; k++) {
-      auto w = makeComplexNumberFromPolar<T>(1.0, -2*M_PI*k/N);
-      X[k] = even[k] + w*odd[k];
-      X[N/2+k] = even[k] - w*odd[k];
-      
-      
+    const auto& w = getTwiddleTable(N);
+    for (int length = 2; length <= N; length <<= 1) {
+      int half = length / 2;
+      int stride = N / length;
+      for (int start = 0; start < N; start += length) {
+        for (int k = 0; k < half; k++) {
+          complexNumber<double> even = x[start + k];
+          complexNumber<double> odd = w[k * stride] * x[start + k + half];
+          x[start + k] = even + odd;
+          x[start + k + half] = even - odd;
+        }
+      }
     }
+  }
 
-    return X;
+  // z is N real samples packed as z[n] = x[2n] + i x[2n + 1], on return it is
+  // X[k] for k < N/2, the rest of X is the conjugate of these.
+  // With Z the FFT of z, the transforms of the even and odd samples are
+  // E[k] = (Z[k] + conj(Z[N/2 - k]))/2 and O[k] = (Z[k] - conj(Z[N/2 - k]))/2i
+  // and X[k] = E[k] + w^k O[k], this is done for k and N/2 - k together.
+  static void realFFTInPlace(std::vector<complexNumber<double>>& z) {
+    int M = z.size();
+    fftInPlace(z);
+    const auto& w = getTwiddleTable(2 * M);
+    z[0] = complexNumber<double>(z[0].a + z[0].b, 0.0);
+    for (int k = 1; k <= M / 2; k++) {
+      complexNumber<double> Zk = z[k];
+      complexNumber<double> ZMk = z[M - k].conjugate();
+      complexNumber<double> even = (Zk + ZMk) * 0.5;
+      complexNumber<double> difference = Zk - ZMk;
+      complexNumber<double> odd(difference.b * 0.5, -difference.a * 0.5);
+      z[k] = even + w[k] * odd;
+      z[M - k] = even.conjugate() + w[M - k] * odd.conjugate();
+    }
   }
 
   void DFT(std::vector<double> time, matrix<T> inputData) {
@@ -90,11 +137,11 @@ public:
     
     for (int k = 0; k < N/2; k++) {
       for (int n = 0; n < N; n++) {
-        auto data = inputData.data[0][n];
+        auto data = inputData[0][n];
         double angle = -2*M_PI*k*n/N;
-        transformData.data[0][k] += (data*makeComplexNumberFromPolar<double>(1, angle));
+        transformData[0][k] += (data*makeComplexNumberFromPolar<double>(1, angle));
       }
-      frequency.data[0][k] = k*fs;
+      frequency[0][k] = k*fs;
     }
 
   };
@@ -102,11 +149,10 @@ public:
   void magnitude() {
     magnitudes.rows = transformData.rows;
     magnitudes.cols = transformData.cols;
-    std::vector<std::vector<double>> magnitudeVec(magnitudes.rows, std::vector<double>(magnitudes.cols, 0.0));
-    magnitudes.data = magnitudeVec;
+    magnitudes.createData();
     for (int row = 0; row < magnitudes.rows; row++) {
       for (int col = 0; col < magnitudes.cols; col++) {
-        magnitudes.data[row][col] = transformData.data[row][col].magnitude();
+        magnitudes[row][col] = transformData[row][col].magnitude();
       }
     }
   };
@@ -114,11 +160,10 @@ public:
   void phase() {
     phases.rows = transformData.rows;
     phases.cols = transformData.cols;
-    std::vector<std::vector<double>> phaseVec(phases.rows, std::vector<double>(phases.cols, 0.0));
-    phases.data = phaseVec;
+    phases.createData();
     for (int row = 0; row < phases.rows; row++) {
       for (int col = 0; col < phases.cols; col++) {
-        phases.data[row][col] = transformData.data[row][col].phase();
+        phases[row][col] = transformData[row][col].phase();
       }
     }
   };
@@ -79,36 +79,49 @@ std::vector<symbol> multiVaribleFunction::getVaribles() {
 }
 
 
+double operation::operator()(double t) const {
+  switch (type) {
+  case CONSTANT: return a;
+  case ADD: return a + t;
+  case MULTIPLY: return a * t;
+  case DIVIDE: return t / a;
+  case SIN: return a*std::sin(b*2*M_PI*t + c);
+  case COS: return a*std::cos(b*2*M_PI + c);
+  case SCALE_TO_ONE: {
+    if (t > 0) return 1;
+    if (t < 0) return -1;
+    return 0;
+  }
+  }
+  return t;
+}
+
 namespace Operation {
   operationPtr constant(double arg) {
-    return [arg](double t) { return arg; };
+    return operation{operation::CONSTANT, arg};
   }
   operationPtr add(double arg) {
-    return [arg](double t) { return arg + t; };
+    return operation{operation::ADD, arg};
   }
 
   operationPtr multiply(double arg) {
-    return [arg](double t) { return arg * t; };
+    return operation{operation::MULTIPLY, arg};
   }
   
   operationPtr divide(double arg) {
-    return [arg](double t) { return t / arg; };
+    return operation{operation::DIVIDE, arg};
   }
 
   operationPtr sin(double A, double frequency, double theta) {
-    return [A, frequency, theta](double t) { return A*std::sin(frequency*2*M_PI*t + theta); };
+    return operation{operation::SIN, A, frequency, theta};
   }
   
   operationPtr cos(double A, double frequency, double theta) {
-    return [A, frequency, theta](double t) { return A*std::cos(frequency*2*M_PI + theta); };
+    return operation{operation::COS, A, frequency, theta};
   }
 
   operationPtr scaleToOne() {
-    return [](double t) {
-      if (t > 0) return 1;
-      if (t < 0) return -1;
-      return 0;
-    };
+    return operation{operation::SCALE_TO_ONE};
   }
   // TODO: add more functions
   
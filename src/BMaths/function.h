@@ -43,6 +43,23 @@ namespace branchOperation {
 typedef std::function<double(double)> operationPtr;
 typedef std::function<double(double, double)> branchPtr;
 
+// The operations made by Operation:: are one of these, so what they do can be
+// read back out of the operationPtr when a function is compiled (see compiledFunction.h)
+struct operation {
+  enum code {
+    CONSTANT,
+    ADD,
+    MULTIPLY,
+    DIVIDE,
+    SIN,
+    COS,
+    SCALE_TO_ONE
+  };
+  code type;
+  double a = 0.0, b = 0.0, c = 0.0;
+  double operator()(double t) const;
+};
+
 // The way we are going to reprsent a function is like a tree.
 // To deal with having more than one instance of a varible we must have a recursive definition
 // Using a simple list of operations would make it 'imposible' to rempresent functions like:
@@ -7,19 +7,72 @@
 #include <iomanip>
 #include "complexNumbers.h"
 #include "function.h"
-#include "matrix.h"
+#include "vectorKernels.h"
+#include "blockedKernels.h"
 
 class function;
 class symbol;
 
+template <typename T> class matrix;
+
+// Non owning strided view into a matrix, used for rows, cols and blocks.
+// The view is only valid while the matrix it points into is alive and not resized.
+template <typename T>
+class matrixView {
+ public:
+  T* start = nullptr;
+  int rows = 0, cols = 0;
+  int rowStride = 0, colStride = 1;
+
+  inline T& operator()(int row, int col) const { return start[row * rowStride + col * colStride]; };
+  matrix<T> copy() const;
+};
+
+// Non owning view of the given rows and cols of a matrix, this lets the DAE
+// splitting code index into the original A and E instead of copying them
+template <typename T>
+class matrixIndexView {
+ public:
+  const matrix<T>* source = nullptr;
+  std::vector<int> rowIdx, colIdx;
+  int rows = 0, cols = 0;
+
+  inline const T& operator()(int row, int col) const { return (*source)(rowIdx[row], colIdx[col]); };
+  matrix<T> copy() const;
+  matrix<T> operator*(const matrix<T>& other) const;
+};
+
+// 0, 1, ..., size - 1
+inline std::vector<int> createIdxRange(int size) {
+  std::vector<int> output(size);
+  for (int i = 0; i < size; i++) {
+    output[i] = i;
+  }
+  return output;
+}
+
+// Stored in one row major buffer, element (row, col) is data[row*cols + col]
 template <typename T>
 class matrix {
  public:
-  std::vector<std::vector<T>> data;
-  int cols, rows;
-  void createData();  
+  matrix() {};
+  matrix(const std::vector<std::vector<T>>& nestedData, int cols, int rows);
+
+  std::vector<T> data;
+  int cols = 0, rows = 0;
+  void createData();
   void print(const std::string name = "") const;
-  
+
+  inline T& operator()(int row, int col) { return data[row * cols + col]; };
+  inline const T& operator()(int row, int col) const { return data[row * cols + col]; };
+  inline T* operator[](int row) { return data.data() + row * cols; };
+  inline const T* operator[](int row) const { return data.data() + row * cols; };
+
+  matrixView<T> getRowView(int row);
+  matrixView<T> getColumnView(int col);
+  matrixView<T> getSubMatrixView(int row, int col, int subRows, int subCols);
+  matrixIndexView<T> getIndexView(const std::vector<int>& rowIdx, const std::vector<int>& colIdx) const;
+
   matrix<T> scale(double scale);
   matrix<T> getColumn(int col);
   matrix<T> getRow(int row);
@@ -31,28 +84,97 @@ class matrix {
   double norm(double Ln);
   double max();
   matrix<T> invert();
-  
+
   template<typename U>
   matrix<T> operator*(const matrix<U>& other);
   matrix<T> operator+(const matrix<T>& other);
   matrix<T> operator-(const matrix<T>& other);
 };
 
+template <typename T>
+matrix<T>::matrix(const std::vector<std::vector<T>>& nestedData, int cols, int rows)
+  : cols(cols), rows(rows) {
+  data.reserve(rows * cols);
+  for (auto& row : nestedData) {
+    data.insert(data.end(), row.begin(), row.end());
+  }
+}
+
+template <typename T>
+matrix<T> createMatrix(int rows, int cols) {
+  matrix<T> output;
+  output.rows = rows;
+  output.cols = cols;
+  output.createData();
+  return output;
+}
+
+template <typename T>
+matrix<T> matrixView<T>::copy() const {
+  matrix<T> output;
+  output.rows = rows;
+  output.cols = cols;
+  output.data.reserve(rows * cols);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      output.data.push_back((*this)(row, col));
+    }
+  }
+  return output;
+}
+
+template <typename T>
+matrix<T> matrixIndexView<T>::copy() const {
+  matrix<T> output;
+  output.rows = rows;
+  output.cols = cols;
+  output.data.reserve(rows * cols);
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      output.data.push_back((*this)(row, col));
+    }
+  }
+  return output;
+}
+
+template <typename T>
+matrix<T> matrixIndexView<T>::operator*(const matrix<T>& other) const {
+  if (cols != other.rows) {
+    std::cerr << "ERROR: For multiply cols of A must be equal to rows of B" << std::endl;
+  }
+  matrix<T> output = createMatrix<T>(rows, other.cols);
+  for (int row = 0; row < rows; ++row) {
+    const T* sourceRow = (*source)[rowIdx[row]];
+    for (int k = 0; k < cols; ++k) {
+      T a = sourceRow[colIdx[k]];
+      if constexpr (std::is_same<T, double>::value) {
+        if (a != 0.0) {
+          axpy(a, other[k], output[row], other.cols);
+        }
+      } else {
+        for (int col = 0; col < other.cols; ++col) {
+          output(row, col) += a * other(k, col);
+        }
+      }
+    }
+  }
+  return output;
+}
 
 template <typename T>
 void matrix<T>::createData() {
   if constexpr (std::is_arithmetic<T>::value) {
-    data = std::vector<std::vector<T>>(rows, std::vector<T>(cols, 0));
-    
+    data = std::vector<T>(rows * cols, 0);
+
   } else if constexpr (std::is_same<T, symbol>::value) {
-    data = std::vector<std::vector<T>>(rows, std::vector<T>(cols, symbol("")));
-    
+    data = std::vector<T>(rows * cols, symbol(""));
+
   } else if constexpr (std::is_same<T, function>::value) {
     function f0 = createConstantFunction(0.0);
-    data = std::vector<std::vector<T>>(rows, std::vector<T>(cols, f0));
-    
+    data = std::vector<T>(rows * cols, f0);
+
   } else if constexpr (std::is_same<T, complexNumber<double>>::value) {
-    data = std::vector<std::vector<T>>(rows, std::vector<T>(cols, complexNumber<double>(0.0, 0.0)));
+    data = std::vector<T>(rows * cols, complexNumber<double>(0.0, 0.0));
   }
 }
 
@@ -62,13 +184,13 @@ void matrix<T>::print(const std::string name) const {
   for (int i = 0; i < rows; i++) {
     for (int j = 0; j < cols; j++) {
       if constexpr (std::is_arithmetic<T>::value) {
-        std::cout << std::scientific << std::setprecision(5) << data[i][j] << " ";
+        std::cout << std::scientific << std::setprecision(5) << (*this)(i, j) << " ";
       } else if constexpr (std::is_same<T, symbol>::value) {
-        std::cout << data[i][j].name << " ";
+        std::cout << (*this)(i, j).name << " ";
       } else if constexpr (std::is_same<T, function>::value) {
-        std::cout << "function evaluated at 0: " << data[i][j].evaluate(0.0) << " ";
+        std::cout << "function evaluated at 0: " << (*this)(i, j).evaluate(0.0) << " ";
       } else if constexpr (std::is_same<T, complexNumber<double>>::value) {
-        data[i][j].print();
+        (*this)(i, j).print();
       }
     }
     std::cout << "\n";
@@ -76,52 +198,71 @@ void matrix<T>::print(const std::string name) const {
   std::cout << "\n";
 }
 
+template <typename T>
+matrixView<T> matrix<T>::getRowView(int row) {
+  return matrixView<T>{data.data() + row * cols, 1, cols, cols, 1};
+}
+
+template <typename T>
+matrixView<T> matrix<T>::getColumnView(int col) {
+  return matrixView<T>{data.data() + col, rows, 1, cols, 1};
+}
+
+template <typename T>
+matrixView<T> matrix<T>::getSubMatrixView(int row, int col, int subRows, int subCols) {
+  return matrixView<T>{data.data() + row * cols + col, subRows, subCols, cols, 1};
+}
+
+template <typename T>
+matrixIndexView<T> matrix<T>::getIndexView(const std::vector<int>& rowIdx, const std::vector<int>& colIdx) const {
+  return matrixIndexView<T>{this, rowIdx, colIdx, (int)rowIdx.size(), (int)colIdx.size()};
+}
+
 template <typename T>
 matrix<T> matrix<T>::scale(double scale) {
-  std::vector<std::vector<T>> outputData(rows, std::vector<T>(cols, 0));
-  for (int row = 0; row < rows; ++row) {
-    for (int col = 0; col < cols; ++col) {
-      outputData[row][col] = scale*data[row][col];
-    }
+  matrix<T> output;
+  output.rows = rows;
+  output.cols = cols;
+  output.data.resize(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    output.data[i] = scale*data[i];
   }
-  matrix<T> output = {
-    outputData,
-    cols, rows
-  };
   return output;
 }
 
 template <typename T>
 matrix<T> matrix<T>::getColumn(int col) {
-  std::vector<std::vector<T>> output;
-  output.reserve(rows);
-  for (int i = 0; i < rows; i++) {
-    output.push_back({data[i][col]});
-  }
-  return matrix<T>{output, 1, rows};
+  return getColumnView(col).copy();
 }
 
+// Returned as a column vector
 template <typename T>
 matrix<T> matrix<T>::getRow(int row) {
-  std::vector<std::vector<T>> output;
-  output.reserve(cols);
-  for (int i = 0; i < cols; i++) {
-    output.push_back({data[row][i]});
-  }
-  return matrix<T>{output, 1, cols};
+  matrix<T> output;
+  output.rows = cols;
+  output.cols = 1;
+  output.data = std::vector<T>(data.begin() + row * cols, data.begin() + (row + 1) * cols);
+  return output;
 }
 
 template <typename T>
 matrix<T> matrix<T>::eliminateRow(int row) {
-  data.erase(data.begin() + row);
+  data.erase(data.begin() + row * cols, data.begin() + (row + 1) * cols);
   rows -= 1;
   return *this;
 }
 template <typename T>
 matrix<T> matrix<T>::eliminateCol(int col) {
+  // Compact in place, each element moves left by the number of removed elements before it
+  int write = 0;
   for (int row = 0; row < rows; row++) {
-    data[row].erase(data[row].begin() + col);
+    for (int c = 0; c < cols; c++) {
+      if (c != col) {
+        data[write++] = std::move(data[row * cols + c]);
+      }
+    }
   }
+  data.resize(write);
   cols -= 1;
   return *this;
 }
@@ -129,11 +270,9 @@ matrix<T> matrix<T>::eliminateCol(int col) {
 // For multivarible functions
 template<typename T>
 matrix<double> matrix<T>::evaluate(std::vector<std::pair<symbol, double>> inputs) {
-  matrix<double> output = {std::vector<std::vector<double>>(rows, std::vector<double>(cols, 0.0)), cols, rows};
-  for (int row = 0; row < output.rows; row++) {
-    for (int col = 0; col < output.cols; col++) {
-      output.data[row][col] = data[row][col].evaluate(inputs);
-    }
+  matrix<double> output = createMatrix<double>(rows, cols);
+  for (size_t i = 0; i < data.size(); i++) {
+    output.data[i] = data[i].evaluate(inputs);
   }
   return output;
   std::cerr << "ERROR: Unreachable" << std::endl;
@@ -144,11 +283,9 @@ matrix<double> matrix<T>::evaluate(double t) {
   if constexpr (std::is_arithmetic<T>::value) {
     return &this;
   } else if constexpr (std::is_same<T, function>::value) {
-    matrix<double> output = {std::vector<std::vector<double>>(rows, std::vector<double>(cols, 0.0)), cols, rows};
-    for (int row = 0; row < output.rows; row++) {
-      for (int col = 0; col < output.cols; col++) {
-        output.data[row][col] = data[row][col].evaluate(t);
-      }
+    matrix<double> output = createMatrix<double>(rows, cols);
+    for (size_t i = 0; i < data.size(); i++) {
+      output.data[i] = data[i].evaluate(t);
     }
     return output;
   }
@@ -158,16 +295,15 @@ matrix<double> matrix<T>::evaluate(double t) {
 
 template <typename T>
 matrix<T> matrix<T>::transpose() {
-  std::vector<std::vector<T>> outputVec(cols, std::vector<T>(rows));
+  matrix<T> output;
+  output.rows = cols;
+  output.cols = rows;
+  output.data.resize(data.size());
   for (int row = 0; row < rows; row++) {
     for (int col = 0; col < cols; col++) {
-      outputVec[col][row] = data[row][col];
+      output.data[col * rows + row] = data[row * cols + col];
     }
   }
-  matrix<T> output = {
-    outputVec,
-    rows, cols
-  };
   return output;
 };
 
@@ -176,9 +312,14 @@ double matrix<T>::norm(double Ln) {
   if (cols > 1) {
     std::cerr << "TODO: Norm with more than one col is not implemented" << std::endl;
   }
+  if constexpr (std::is_same<T, double>::value) {
+    if (Ln == 2.0 && cols == 1) {
+      return norm2(data.data(), rows);
+    }
+  }
   double norm = 0.0;
   for (int row = 0; row < rows; ++row) {
-    norm += std::pow(data[row][0], Ln);
+    norm += std::pow((*this)(row, 0), Ln);
   }
   norm = std::pow(norm, 1/Ln);
   return norm;
@@ -187,11 +328,9 @@ double matrix<T>::norm(double Ln) {
 template <typename T>
 double matrix<T>::max() {
   double max = 0.0;
-  for (int row = 0; row < rows; ++row) {
-    for (int col = 0; col < cols; ++col) {
-      if (data[row][col] > max) {
-        max = data[row][col];
-      }
+  for (auto& value : data) {
+    if (value > max) {
+      max = value;
     }
   }
   return max;
@@ -199,64 +338,83 @@ double matrix<T>::max() {
 
 template <typename T>
 matrix<T> matrix<T>::invert() {
-  std::vector<std::vector<double>> inverse = std::vector<std::vector<double>>(rows, std::vector<double>(rows, 0));
-    std::vector<std::vector<double>> augmented(rows, std::vector<double>(2 * rows, 0));
-
-    // Create the augmented matrix [input | I]
+  // Blocked LU and then A X = I, this is the same O(N^3) as Gauss-Jordan but most of it is gemm
+  if constexpr (std::is_same<T, double>::value) {
+    std::vector<double> LU = data;
+    std::vector<int> perm(rows);
+    matrix<T> inv = createMatrix<T>(rows, rows);
+    if (!blockedLU(LU.data(), rows, perm.data())) {
+      print();
+      std::cerr << "ERROR: matrix is singular" << std::endl;
+      return inv;
+    }
     for (int i = 0; i < rows; i++) {
-      for (int j = 0; j < rows; j++) {
-        augmented[i][j] = data[i][j];
-      }
-      augmented[i][i + rows] = 1; // Identity matrix
+      inv(i, i) = 1.0;
     }
+    blockedLUSolve(LU.data(), perm.data(), rows, inv.data.data(), rows);
+    return inv;
+  }
+  int width = 2 * rows;
+  std::vector<double> augmented(rows * width, 0);
 
-    // Apply Gaussian elimination
-    for (int i = 0; i < rows; i++) {
-      // Search for maximum in this column
-      double maxEl = abs(augmented[i][i]);
-      int maxRow = i;
-      for (int k = i + 1; k < rows; k++) {
-        if (abs(augmented[k][i]) > maxEl) {
-          maxEl = abs(augmented[k][i]);
-          maxRow = k;
-        }
-      }
+  // Create the augmented matrix [input | I]
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < rows; j++) {
+      augmented[i * width + j] = (*this)(i, j);
+    }
+    augmented[i * width + i + rows] = 1; // Identity matrix
+  }
 
-      // Swap maximum row with current row
-      for (int k = i; k < 2 * rows; k++) {
-        std::swap(augmented[maxRow][k], augmented[i][k]);
+  // Apply Gaussian elimination
+  for (int i = 0; i < rows; i++) {
+    // Search for maximum in this column
+    double maxEl = abs(augmented[i * width + i]);
+    int maxRow = i;
+    for (int k = i + 1; k < rows; k++) {
+      if (abs(augmented[k * width + i]) > maxEl) {
+        maxEl = abs(augmented[k * width + i]);
+        maxRow = k;
       }
+    }
 
-      // Make the diagonal contain all 1s
-      double diag = augmented[i][i];
-      if (diag == 0) {
-        print();
-        std::cerr << "ERROR: matrix is singular" << std::endl;
-      }
-      for (int k = 0; k < 2 * rows; k++) {
-        augmented[i][k] /= diag;
-      }
+    // Swap maximum row with current row
+    for (int k = i; k < width; k++) {
+      std::swap(augmented[maxRow * width + k], augmented[i * width + k]);
+    }
 
-      // Make the other rows contain 0s in this column
-      for (int k = 0; k < rows; k++) {
-        if (k != i) {
-          double factor = augmented[k][i];
-          for (int j = 0; j < 2 * rows; j++) {
-            augmented[k][j] -= factor * augmented[i][j];
-          }
+    // Make the diagonal contain all 1s
+    double diag = augmented[i * width + i];
+    if (diag == 0) {
+      print();
+      std::cerr << "ERROR: matrix is singular" << std::endl;
+    }
+    for (int k = 0; k < width; k++) {
+      augmented[i * width + k] /= diag;
+    }
+
+    // Make the other rows contain 0s in this column
+    for (int k = 0; k < rows; k++) {
+      if (k != i) {
+        double factor = augmented[k * width + i];
+        for (int j = 0; j < width; j++) {
+          augmented[k * width + j] -= factor * augmented[i * width + j];
         }
       }
     }
+  }
 
-    // Extract the inverse matrix from the augmented matrix
-    for (int i = 0; i < rows; i++) {
-      for (int j = 0; j < rows; j++) {
-        inverse[i][j] = augmented[i][j + rows];
-      }
+  // Extract the inverse matrix from the augmented matrix
+  matrix<T> inv;
+  inv.rows = rows;
+  inv.cols = cols;
+  inv.data.resize(rows * rows);
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < rows; j++) {
+      inv(i, j) = augmented[i * width + j + rows];
     }
-    matrix<T> inv = {inverse, cols, rows};
-    return inv;
   }
+  return inv;
+}
 
 
 template<typename T>
@@ -267,20 +425,26 @@ matrix<T> matrix<T>::operator*(const matrix<U>& other) {
     this->print("A:");
     other.print("B:");
   }
-  std::vector<std::vector<T>> outputData(this->rows, std::vector<T>(other.cols));
-
-
+  matrix<T> output;
+  output.rows = this->rows;
+  output.cols = other.cols;
+  output.data = std::vector<T>(output.rows * output.cols);
+
+  if constexpr (std::is_same<T, double>::value && std::is_same<U, double>::value) {
+    if (other.cols == 1) {
+      matVec(data.data(), this->rows, this->cols, other.data.data(), output.data.data());
+    } else {
+      matMul(data.data(), other.data.data(), output.data.data(), this->rows, this->cols, other.cols);
+    }
+    return output;
+  }
   for (int row = 0; row < this->rows; ++row) {
     for (int col = 0; col < other.cols; ++col) {
       for (int k = 0; k < this->cols; ++k) {
-        outputData[row][col] = outputData[row][col] + (this->data[row][k] * other.data[k][col]);
+        output(row, col) = output(row, col) + ((*this)(row, k) * other(k, col));
       }
     }
   }
-  matrix<T> output = {
-    outputData,
-    other.cols, this->rows
-  };
 
   return output;
 }
@@ -293,16 +457,13 @@ matrix<T> matrix<T>::operator-(const matrix<T>& other) {
     this->print("A");
     other.print("B");
   }
-  std::vector<std::vector<T>> outputData(this->rows, std::vector<T>(this->cols, 0));
-  for (int row = 0; row < this->rows; ++row) {
-    for (int col = 0; col < this->cols; ++col) {
-      outputData[row][col] = this->data[row][col] - other.data[row][col];
-    }
+  matrix<T> output;
+  output.rows = this->rows;
+  output.cols = this->cols;
+  output.data.resize(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    output.data[i] = this->data[i] - other.data[i];
   }
-  matrix<T> output = {
-    outputData,
-    this->cols, this->rows
-  };
   return output;
 }
 
@@ -311,16 +472,12 @@ matrix<T> matrix<T>::operator-(const matrix<T>& other) {
 template<typename T>
 matrix<T> matrix<T>::operator+(const matrix<T>& other) {
   if (this->cols != other.cols || this->rows != other.rows) { std::cerr << "ERROR: Mismatched matrix sizes" << std::endl; }
-  std::vector<std::vector<T>> outputData(this->rows, std::vector<T>(this->cols, 0));
-  for (int row = 0; row < this->rows; ++row) {
-    for (int col = 0; col < this->cols; ++col) {
-      outputData[row][col] = this->data[row][col] + other.data[row][col];
-    }
+  matrix<T> output;
+  output.rows = this->rows;
+  output.cols = this->cols;
+  output.data.resize(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    output.data[i] = this->data[i] + other.data[i];
   }
-  matrix<T> output = {
-    outputData,
-    this->cols, this->rows
-  };
   return output;
 }
-
@@ -0,0 +1,164 @@
+#include "newtonSolver.h"
+#include <cmath>
+#include <algorithm>
+
+// Where (row, col) is in the values of a compressed matrix
+static int findSlot(const sparseMatrix<double>& A, int row, int col) {
+  auto begin = A.colIdx.begin() + A.rowStart[row];
+  auto end = A.colIdx.begin() + A.rowStart[row + 1];
+  return std::lower_bound(begin, end, col) - A.colIdx.begin();
+}
+
+void newtonSolver::setLinear(const sparseMatrix<double>& MIn) {
+  M = MIn;
+  if (!M.isCompressed()) {
+    M.compress();
+  }
+  int n = M.rows;
+  J.rows = n;
+  J.cols = n;
+  J.createData();
+  for (int row = 0; row < n; row++) {
+    for (int p = M.rowStart[row]; p < M.rowStart[row + 1]; p++) {
+      J.at(row, M.colIdx[p]) += 0.0;
+    }
+  }
+  deviceSlots.clear();
+  deviceJacobians.clear();
+  for (auto& device : devices) {
+    for (auto& entry : device->jacobianEntries()) {
+      J.at(entry.first, entry.second) += 0.0;
+    }
+  }
+  J.compress();
+
+  MSlots = std::vector<int>(M.values.size());
+  for (int row = 0; row < n; row++) {
+    for (int p = M.rowStart[row]; p < M.rowStart[row + 1]; p++) {
+      MSlots[p] = findSlot(J, row, M.colIdx[p]);
+    }
+  }
+  for (auto& device : devices) {
+    std::vector<int> slots;
+    for (auto& entry : device->jacobianEntries()) {
+      slots.push_back(findSlot(J, entry.first, entry.second));
+    }
+    deviceJacobians.push_back(std::vector<double>(slots.size(), 0.0));
+    deviceSlots.push_back(slots);
+  }
+  F = std::vector<double>(n);
+  xNew = std::vector<double>(n);
+  isFactored = false;
+}
+
+bool newtonSolver::residual(const std::vector<double>& b, const std::vector<double>& x) {
+  for (int row = 0; row < M.rows; row++) {
+    double sum = -b[row];
+    for (int p = M.rowStart[row]; p < M.rowStart[row + 1]; p++) {
+      sum += M.values[p] * x[M.colIdx[p]];
+    }
+    F[row] = sum;
+  }
+  bool limited = false;
+  for (int d = 0; d < (int)devices.size(); d++) {
+    limited = devices[d]->load(x, F, deviceJacobians[d]) || limited;
+  }
+  return limited;
+}
+
+// J = M + the device Jacobians from the last call to residual()
+bool newtonSolver::factor() {
+  std::fill(J.values.begin(), J.values.end(), 0.0);
+  for (int p = 0; p < (int)M.values.size(); p++) {
+    J.values[MSlots[p]] += M.values[p];
+  }
+  for (int d = 0; d < (int)devices.size(); d++) {
+    for (int k = 0; k < (int)deviceSlots[d].size(); k++) {
+      J.values[deviceSlots[d][k]] += deviceJacobians[d][k];
+    }
+  }
+  if (useSparse) {
+    JSparseLU.factor(J);
+    isFactored = !JSparseLU.isSingular;
+  } else {
+    JDenseLU.factor(J.toDense());
+    isFactored = !JDenseLU.isSingular;
+  }
+  factorizations++;
+  return isFactored;
+}
+
+void newtonSolver::solveInPlace(std::vector<double>& x) const {
+  if (useSparse) {
+    JSparseLU.solveInPlace(x);
+  } else {
+    JDenseLU.solveInPlace(x);
+  }
+}
+
+bool newtonSolver::solve(const std::vector<double>& b, std::vector<double>& x) {
+  int n = M.rows;
+  if (devices.empty()) {
+    // Linear, the Jacobian is M so one solve is exact
+    if (!isFactored) {
+      if (!factor()) {
+        return false;
+      }
+    }
+    x = b;
+    solveInPlace(x);
+    iterations++;
+    return true;
+  }
+
+  bool refactor = !isFactored || !options.reuseJacobian;
+  bool reused = false;
+  double lastNorm = INFINITY;
+  for (int i = 0; i < options.maxIt; i++) {
+    bool limited = residual(b, x);
+    if (refactor) {
+      if (!factor()) {
+        return false;
+      }
+      refactor = !options.reuseJacobian;
+      reused = false;
+    } else {
+      reused = true;
+    }
+    iterations++;
+    // x(k+1) = x(k) - J^-1 F
+    std::vector<double>& delta = F;
+    solveInPlace(delta);
+    for (int row = 0; row < n; row++) {
+      xNew[row] = x[row] - delta[row];
+    }
+
+    double norm = 0.0;
+    bool converged = true;
+    for (int row = 0; row < n; row++) {
+      double change = std::abs(xNew[row] - x[row]);
+      norm = std::max(norm, change);
+      if (change > options.absTol + options.relTol * std::abs(xNew[row])) {
+        converged = false;
+      }
+    }
+    if (!std::isfinite(norm)) {
+      if (!reused) {
+        return false;
+      }
+      // An old Jacobian sent it off, try again from the same point with a new one
+      refactor = true;
+      continue;
+    }
+    x = xNew;
+    if (converged && !limited) {
+      return true;
+    }
+    // Slow convergence means the Jacobian is too far out of date
+    if (norm > options.reuseContraction * lastNorm) {
+      refactor = true;
+    }
+    lastNorm = norm;
+  }
+  return false;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "sparseMatrix.h"
+#include "sparseLU.h"
+#include "denseLU.h"
+#include "nonlinearDevice.h"
+
+struct NewtonOptions {
+  int maxIt = 100;
+  // Converged when every update is below absTol + relTol |x|
+  double absTol = 1e-9;
+  double relTol = 1e-6;
+  // Modified Newton, the factored Jacobian is kept between iterations (and solves)
+  // as long as each update is at most reuseContraction times the one before
+  bool reuseJacobian = true;
+  double reuseContraction = 0.5;
+};
+
+// Solves M x + i(x) = b, where M is linear and i(x) is the sum of the device currents.
+// The Jacobian M + di/dx has the pattern of M plus the device entries, this is
+// worked out once in setLinear() along with where each device entry goes, so
+// building the Jacobian is only a copy of M and a scatter of the device values.
+// With no devices this is a single linear solve with factors that are never redone.
+class newtonSolver {
+public:
+  newtonSolver() {};
+  newtonSolver(const std::vector<std::shared_ptr<nonlinearDevice>>& devices, bool useSparse = true)
+    : devices(devices), useSparse(useSparse) {};
+
+  // The linear part, this throws away the old factors
+  void setLinear(const sparseMatrix<double>& M);
+  // x is the starting guess and the result, false if it did not converge
+  bool solve(const std::vector<double>& b, std::vector<double>& x);
+  // The next solve starts with a new Jacobian
+  void invalidate() { isFactored = false; };
+
+  NewtonOptions options;
+  std::vector<std::shared_ptr<nonlinearDevice>> devices;
+  bool useSparse = true;
+  // Totals over every solve
+  int iterations = 0;
+  int factorizations = 0;
+
+private:
+  sparseMatrix<double> M, J;
+  std::vector<int> MSlots; // MSlots[p] is where M.values[p] goes in J.values
+  std::vector<std::vector<int>> deviceSlots;
+  std::vector<std::vector<double>> deviceJacobians;
+  std::vector<double> F, xNew;
+  sparseLU JSparseLU;
+  denseLU<double> JDenseLU;
+  bool isFactored = false;
+
+  // F = M x + i(x) - b, also loads the device Jacobians at x.
+  // Returns true if any device limited its step
+  bool residual(const std::vector<double>& b, const std::vector<double>& x);
+  bool factor();
+  void solveInPlace(std::vector<double>& x) const;
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+// A device whose current is a nonlinear function of the unknowns, like a diode.
+// The Newton solver asks for the Jacobian entries once, then each iteration the
+// device adds its currents to the residual and writes its analytic derivatives,
+// so nothing has to be found by finite differences.
+class nonlinearDevice {
+public:
+  virtual ~nonlinearDevice() = default;
+  // The (row, col) entries of the Jacobian that the device writes to
+  virtual std::vector<std::pair<int, int>> jacobianEntries() const = 0;
+  // residual[row] += the current leaving the node of that row,
+  // jacobian[k] = d current / dx for entry k of jacobianEntries().
+  // A device can limit how far its voltages move from the last load, it is then
+  // linearised around the limited point and load() returns true, so the solver
+  // knows it has not converged yet.
+  virtual bool load(const std::vector<double>& x, std::vector<double>& residual, std::vector<double>& jacobian) = 0;
+  // output[row] += the current leaving the node of that row at x, without limiting
+  // and without changing the state, the trapezoidal rule needs i(x) at the last point
+  virtual void addCurrents(const std::vector<double>& x, std::vector<double>& output) const = 0;
+  // jacobian[k] = d current / dx at x for entry k of jacobianEntries(), also without limiting.
+  // At the operating point this is the small signal model used by the AC sweep
+  virtual void smallSignal(const std::vector<double>& x, std::vector<double>& jacobian) const = 0;
+  // Devices keep state between loads, so each solver running at the same time needs its own copy
+  virtual std::shared_ptr<nonlinearDevice> clone() const = 0;
+};
+
+// Shockley diode, I = Is (e^(v/(n Vt)) - 1) from the anode to the cathode.
+// anode and cathode are the rows of the node voltages, -1 if it is connected to
+// ground so that the ground row (v = 0) is not changed.
+class diodeDevice : public nonlinearDevice {
+public:
+  diodeDevice(int anode, int cathode, double saturationCurrent = 1e-14, double emissionCoefficient = 1.0)
+    : anode(anode), cathode(cathode), saturationCurrent(saturationCurrent) {
+    nVt = emissionCoefficient * thermalVoltage;
+    criticalVoltage = nVt * std::log(nVt / (std::sqrt(2.0) * saturationCurrent));
+  };
+
+  static constexpr double thermalVoltage = 0.025852; // kT/q at 300K
+
+  // The saturation current that gives a current of 1mA at voltageDrop
+  static double saturationCurrentFromDrop(double voltageDrop, double emissionCoefficient = 1.0) {
+    return 1e-3 / (std::exp(voltageDrop / (emissionCoefficient * thermalVoltage)) - 1.0);
+  };
+
+  double current(double v) const {
+    // Past maxExponent the exponential is continued as a straight line so it can not overflow
+    double u = v / nVt;
+    if (u > maxExponent) {
+      double e = std::exp(maxExponent);
+      return saturationCurrent * (e * (1.0 + u - maxExponent) - 1.0);
+    }
+    return saturationCurrent * (std::exp(u) - 1.0);
+  };
+
+  double conductance(double v) const {
+    return saturationCurrent * std::exp(std::min(v / nVt, maxExponent)) / nVt;
+  };
+
+  std::shared_ptr<nonlinearDevice> clone() const override {
+    return std::make_shared<diodeDevice>(*this);
+  };
+
+  std::vector<std::pair<int, int>> jacobianEntries() const override {
+    std::vector<std::pair<int, int>> output;
+    if (anode >= 0) output.push_back({anode, anode});
+    if (anode >= 0 && cathode >= 0) output.push_back({anode, cathode});
+    if (anode >= 0 && cathode >= 0) output.push_back({cathode, anode});
+    if (cathode >= 0) output.push_back({cathode, cathode});
+    return output;
+  };
+
+  bool load(const std::vector<double>& x, std::vector<double>& residual, std::vector<double>& jacobian) override {
+    double v = voltage(x);
+    double vLimited = limit(v, lastVoltage);
+    lastVoltage = vLimited;
+    double g = conductance(vLimited);
+    // The current on the tangent line at vLimited
+    double i = current(vLimited) + g * (v - vLimited);
+    int k = 0;
+    if (anode >= 0) {
+      residual[anode] += i;
+      jacobian[k++] = g;
+    }
+    if (anode >= 0 && cathode >= 0) {
+      jacobian[k++] = -g;
+      jacobian[k++] = -g;
+    }
+    if (cathode >= 0) {
+      residual[cathode] -= i;
+      jacobian[k++] = g;
+    }
+    return vLimited != v;
+  };
+
+  void addCurrents(const std::vector<double>& x, std::vector<double>& output) const override {
+    double i = current(voltage(x));
+    if (anode >= 0) {
+      output[anode] += i;
+    }
+    if (cathode >= 0) {
+      output[cathode] -= i;
+    }
+  };
+
+  void smallSignal(const std::vector<double>& x, std::vector<double>& jacobian) const override {
+    double g = conductance(voltage(x));
+    int k = 0;
+    if (anode >= 0) {
+      jacobian[k++] = g;
+    }
+    if (anode >= 0 && cathode >= 0) {
+      jacobian[k++] = -g;
+      jacobian[k++] = -g;
+    }
+    if (cathode >= 0) {
+      jacobian[k++] = g;
+    }
+  };
+
+  // The junction limiting from SPICE (pnjlim), large forward steps are
+  // replaced by a log step so the exponential does not blow up
+  double limit(double vNew, double vOld) const {
+    if (vNew <= criticalVoltage || std::abs(vNew - vOld) <= 2.0 * nVt) {
+      return vNew;
+    }
+    if (vOld > 0.0) {
+      double arg = 1.0 + (vNew - vOld) / nVt;
+      return (arg > 0.0) ? vOld + nVt * std::log(arg) : criticalVoltage;
+    }
+    return nVt * std::log(vNew / nVt);
+  };
+
+  int anode, cathode;
+  double saturationCurrent;
+
+private:
+  double nVt;
+  double criticalVoltage;
+  double lastVoltage = 0.0; // the voltage of the last load, after limiting
+  static constexpr double maxExponent = 80.0;
+
+  double voltage(const std::vector<double>& x) const {
+    return (anode >= 0 ? x[anode] : 0.0) - (cathode >= 0 ? x[cathode] : 0.0);
+  };
+};
@@ -0,0 +1,227 @@
+#include "ordering.h"
+#include <algorithm>
+#include <set>
+#include <utility>
+
+// The neighbours of each node in A + A^T, sorted and without the diagonal
+static std::vector<std::vector<int>> symmetricPattern(const sparseMatrix<double>& A) {
+  int n = A.rows;
+  std::vector<std::vector<int>> adjacency(n);
+  for (int row = 0; row < n; row++) {
+    for (int p = A.rowStart[row]; p < A.rowStart[row + 1]; p++) {
+      int col = A.colIdx[p];
+      if (col != row) {
+        adjacency[row].push_back(col);
+        adjacency[col].push_back(row);
+      }
+    }
+  }
+  for (auto& neighbours : adjacency) {
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+  }
+  return adjacency;
+}
+
+// Breadth first from start over the nodes that are not visited, returns them in the
+// order they were reached with the neighbours of each node taken by increasing degree
+static std::vector<int> cuthillMcKee(const std::vector<std::vector<int>>& adjacency, int start, std::vector<bool>& visited) {
+  std::vector<int> output = {start};
+  visited[start] = true;
+  std::vector<int> next;
+  for (int head = 0; head < (int)output.size(); head++) {
+    next.clear();
+    for (int neighbour : adjacency[output[head]]) {
+      if (!visited[neighbour]) {
+        visited[neighbour] = true;
+        next.push_back(neighbour);
+      }
+    }
+    std::stable_sort(next.begin(), next.end(), [&](int a, int b) {
+      return adjacency[a].size() < adjacency[b].size();
+    });
+    output.insert(output.end(), next.begin(), next.end());
+  }
+  return output;
+}
+
+std::vector<int> reverseCuthillMcKeeOrdering(const sparseMatrix<double>& A) {
+  int n = A.rows;
+  auto adjacency = symmetricPattern(A);
+  std::vector<bool> visited(n, false);
+  std::vector<int> output;
+  output.reserve(n);
+  std::vector<int> byDegree = createIdxRange(n);
+  std::stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) {
+    return adjacency[a].size() < adjacency[b].size();
+  });
+  for (int start : byDegree) {
+    if (visited[start]) {
+      continue;
+    }
+    // The last node reached from a low degree node is far out, start again from there
+    std::vector<bool> trial = visited;
+    auto reached = cuthillMcKee(adjacency, start, trial);
+    int farthest = reached.back();
+    auto part = cuthillMcKee(adjacency, farthest, visited);
+    output.insert(output.end(), part.begin(), part.end());
+  }
+  std::reverse(output.begin(), output.end());
+  return output;
+}
+
+std::vector<int> minimumDegreeOrdering(const sparseMatrix<double>& A) {
+  int n = A.rows;
+  auto adjacency = symmetricPattern(A);
+  std::set<std::pair<int, int>> queue; // (degree, node)
+  for (int node = 0; node < n; node++) {
+    queue.insert({(int)adjacency[node].size(), node});
+  }
+  std::vector<int> output;
+  output.reserve(n);
+  std::vector<int> joined;
+  while (!queue.empty()) {
+    int node = queue.begin()->second;
+    queue.erase(queue.begin());
+    output.push_back(node);
+    // The neighbours of node become a clique once it is eliminated
+    const auto neighbours = std::move(adjacency[node]);
+    adjacency[node].clear();
+    for (int neighbour : neighbours) {
+      auto& adjacent = adjacency[neighbour];
+      queue.erase({(int)adjacent.size(), neighbour});
+      joined.clear();
+      std::set_union(adjacent.begin(), adjacent.end(), neighbours.begin(), neighbours.end(), std::back_inserter(joined));
+      joined.erase(std::remove_if(joined.begin(), joined.end(), [&](int other) {
+        return other == neighbour || other == node;
+      }), joined.end());
+      adjacent.swap(joined);
+      queue.insert({(int)adjacent.size(), neighbour});
+    }
+  }
+  return output;
+}
+
+// Looks for an augmenting path from col start, depth first with an explicit stack.
+// next[col] is where the search of a col is up to so each search only passes each entry once
+static bool augment(int start, const sparseMatrix<double>& Acsc, std::vector<int>& rowMatch, std::vector<int>& colMatch,
+                    std::vector<int>& visited, std::vector<int>& next, std::vector<int>& cols, std::vector<int>& rows) {
+  int head = 0;
+  cols[0] = start;
+  next[start] = Acsc.rowStart[start];
+  visited[start] = start;
+  while (head >= 0) {
+    int col = cols[head];
+    bool pushed = false;
+    for (int& p = next[col]; p < Acsc.rowStart[col + 1]; p++) {
+      int row = Acsc.colIdx[p];
+      if (rowMatch[row] < 0) {
+        // Flip the matches along the path
+        rows[head] = row;
+        for (int step = head; step >= 0; step--) {
+          colMatch[cols[step]] = rows[step];
+          rowMatch[rows[step]] = cols[step];
+        }
+        return true;
+      }
+      int matched = rowMatch[row];
+      if (visited[matched] != start) {
+        visited[matched] = start;
+        rows[head] = row;
+        p++;
+        cols[++head] = matched;
+        next[matched] = Acsc.rowStart[matched];
+        pushed = true;
+        break;
+      }
+    }
+    if (!pushed) {
+      head--;
+    }
+  }
+  return false;
+}
+
+bool findBlockTriangularForm(const sparseMatrix<double>& A, blockTriangularForm& output) {
+  int n = A.rows;
+  auto Acsc = A.transpose();
+  std::vector<int> rowMatch(n, -1), colMatch(n, -1);
+  // Most cols can take a free row straight away
+  for (int col = 0; col < n; col++) {
+    for (int p = Acsc.rowStart[col]; p < Acsc.rowStart[col + 1]; p++) {
+      int row = Acsc.colIdx[p];
+      if (rowMatch[row] < 0) {
+        rowMatch[row] = col;
+        colMatch[col] = row;
+        break;
+      }
+    }
+  }
+  std::vector<int> visited(n, -1), next(n), cols(n), rows(n);
+  for (int col = 0; col < n; col++) {
+    if (colMatch[col] < 0 && !augment(col, Acsc, rowMatch, colMatch, visited, next, cols, rows)) {
+      return false;
+    }
+  }
+
+  // Tarjan on the graph with an edge from col j to col k when A(colMatch[j], k) is non zero
+  std::vector<int> index(n, -1), low(n), edge(n), stack, callStack;
+  std::vector<bool> onStack(n, false);
+  std::vector<std::vector<int>> blocks;
+  int counter = 0;
+  for (int root = 0; root < n; root++) {
+    if (index[root] >= 0) {
+      continue;
+    }
+    callStack.push_back(root);
+    index[root] = low[root] = counter++;
+    edge[root] = A.rowStart[colMatch[root]];
+    stack.push_back(root);
+    onStack[root] = true;
+    while (!callStack.empty()) {
+      int node = callStack.back();
+      int row = colMatch[node];
+      if (edge[node] < A.rowStart[row + 1]) {
+        int other = A.colIdx[edge[node]++];
+        if (index[other] < 0) {
+          index[other] = low[other] = counter++;
+          edge[other] = A.rowStart[colMatch[other]];
+          stack.push_back(other);
+          onStack[other] = true;
+          callStack.push_back(other);
+        } else if (onStack[other]) {
+          low[node] = std::min(low[node], index[other]);
+        }
+        continue;
+      }
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        low[callStack.back()] = std::min(low[callStack.back()], low[node]);
+      }
+      if (low[node] == index[node]) {
+        blocks.emplace_back();
+        int member;
+        do {
+          member = stack.back();
+          stack.pop_back();
+          onStack[member] = false;
+          blocks.back().push_back(member);
+        } while (member != node);
+      }
+    }
+  }
+
+  // Tarjan finds a block after every block it leads to, reversed they go top to bottom
+  output.rowOrder.clear();
+  output.colOrder.clear();
+  output.blockStart = {0};
+  for (auto block = blocks.rbegin(); block != blocks.rend(); block++) {
+    std::sort(block->begin(), block->end());
+    for (int col : *block) {
+      output.colOrder.push_back(col);
+      output.rowOrder.push_back(colMatch[col]);
+    }
+    output.blockStart.push_back(output.colOrder.size());
+  }
+  return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include "sparseMatrix.h"
+
+// Fill reducing orderings for sparseLU, worked out from the pattern of A + A^T.
+// output[k] is the row (and col) of A that goes k-th, so the matrix that is factored is
+// A(output, output). The numbering in syms stays the same, only the factorization sees the order.
+
+// Reverse Cuthill-McKee, keeps the non zeros in a narrow band around the diagonal.
+// Each connected part starts from a far out node of low degree
+std::vector<int> reverseCuthillMcKeeOrdering(const sparseMatrix<double>& A);
+
+// Minimum degree, each step eliminates the node with the fewest neighbours in the
+// elimination graph and joins its neighbours up, ties go to the lowest index.
+// The degrees are exact instead of AMD's bounds, for circuits the graphs are small enough
+std::vector<int> minimumDegreeOrdering(const sparseMatrix<double>& A);
+
+// A(rowOrder, colOrder) is block upper triangular with no zeros on its diagonal, block b is
+// rows and cols blockStart[b] to blockStart[b + 1] - 1. Only the blocks on the diagonal need
+// to be factored, the parts above them are dealt with by back substitution
+struct blockTriangularForm {
+  std::vector<int> rowOrder, colOrder, blockStart;
+};
+
+// Matches every col to a row (maximum transversal) then splits the graph of the matched
+// matrix into strongly connected parts with Tarjan's algorithm.
+// False if A is structurally singular, then there is no matching to build the blocks from
+bool findBlockTriangularForm(const sparseMatrix<double>& A, blockTriangularForm& output);
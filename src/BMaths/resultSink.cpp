@@ -0,0 +1,127 @@
+#include "resultSink.h"
+#include <iostream>
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+
+void columnStoreSink::begin(int size, int points) {
+  time.clear();
+  time.reserve(points);
+  pointCount = 0;
+  columns = std::vector<matrix<double>>(size, matrix<double>{{{}}, 0, 1});
+  if (storeAll) {
+    for (auto& c : columns) {
+      c.data.reserve(points);
+    }
+  }
+  for (auto& p : probes) {
+    if (p.row < 0 || p.row >= size || p.decimation < 1) {
+      std::cerr << "ERROR: Probe of row " << p.row << " every " << p.decimation << " points is not valid" << std::endl;
+      continue;
+    }
+    columns[p.row].data.reserve((points + p.decimation - 1) / p.decimation);
+  }
+}
+
+void columnStoreSink::add(double t, const std::vector<double>& x) {
+  time.push_back(t);
+  if (storeAll) {
+    for (int row = 0; row < (int)columns.size(); row++) {
+      columns[row].data.push_back(x[row]);
+      columns[row].cols++;
+    }
+  } else {
+    for (auto& p : probes) {
+      if (p.row >= 0 && p.row < (int)columns.size() && p.decimation >= 1 && pointCount % p.decimation == 0) {
+        columns[p.row].data.push_back(x[p.row]);
+        columns[p.row].cols++;
+      }
+    }
+  }
+  pointCount++;
+}
+
+std::pair<std::vector<double>, std::vector<matrix<double>>> columnStoreSink::take() {
+  return {std::move(time), std::move(columns)};
+}
+
+std::streampos writeRawHeader(std::ostream& file, const std::string& title, const std::string& plotName,
+                              const std::vector<std::string>& names, const std::vector<std::string>& types, int points) {
+  std::time_t now = std::time(nullptr);
+  char date[64];
+  std::strftime(date, sizeof(date), "%a %b %d %H:%M:%S %Y", std::localtime(&now));
+  file << "Title: " << title << "\n";
+  file << "Date: " << date << "\n";
+  file << "Plotname: " << plotName << "\n";
+  file << "Flags: real\n";
+  file << "No. Variables: " << names.size() << "\n";
+  file << "No. Points: ";
+  std::streampos location = file.tellp();
+  // Padded so the real number fits when it is written over this
+  file << std::left << std::setw(12) << points << "\n";
+  file << "Variables:\n";
+  for (int i = 0; i < (int)names.size(); i++) {
+    file << "\t" << i << "\t" << names[i] << "\t" << (i < (int)types.size() ? types[i] : "notype") << "\n";
+  }
+  file << "Binary:\n";
+  return location;
+}
+
+void writeRawPoints(std::ostream& file, std::streampos location, int points) {
+  std::streampos end = file.tellp();
+  file.seekp(location);
+  file << std::left << std::setw(12) << points;
+  file.seekp(end);
+}
+
+rawSink::rawSink(const std::string& fileName, const std::string& title, const std::vector<std::string>& names,
+                 const std::vector<std::string>& types, int bufferPoints)
+  : file(fileName, std::ios::binary), title(title), bufferPoints(std::max(bufferPoints, 1)) {
+  if (!file.is_open()) {
+    std::cerr << "ERROR: Unable to open `" << fileName << "` for writing" << std::endl;
+  }
+  this->names.push_back("time");
+  this->names.insert(this->names.end(), names.begin(), names.end());
+  this->types.push_back("time");
+  this->types.insert(this->types.end(), types.begin(), types.end());
+}
+
+rawSink::~rawSink() {
+  end();
+}
+
+void rawSink::begin(int size, int points) {
+  buffer.clear();
+  buffer.reserve((size + 1) * bufferPoints);
+  pointCount = 0;
+  if (size + 1 != (int)names.size()) {
+    std::cerr << "ERROR: " << size << " unknowns but " << names.size() - 1 << " names for the raw file" << std::endl;
+  }
+  if (file.is_open()) {
+    pointsLocation = writeRawHeader(file, title, "Transient Analysis", names, types, points);
+  }
+}
+
+void rawSink::add(double t, const std::vector<double>& x) {
+  buffer.push_back(t);
+  buffer.insert(buffer.end(), x.begin(), x.end());
+  pointCount++;
+  if (pointCount % bufferPoints == 0) {
+    flush();
+  }
+}
+
+void rawSink::end() {
+  flush();
+  if (file.is_open() && pointsLocation != std::streampos(-1)) {
+    writeRawPoints(file, pointsLocation, pointCount);
+  }
+  file.flush();
+}
+
+void rawSink::flush() {
+  if (!buffer.empty() && file.is_open()) {
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(double));
+  }
+  buffer.clear();
+}
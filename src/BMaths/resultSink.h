@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <utility>
+#include "matrix.h"
+
+// Where a solver puts each output point as soon as it has it.
+// The solver only keeps the last few states itself, so how much memory a run
+// takes is up to the sink: columnStoreSink keeps everything, rawSink writes the
+// points out as they come and nullSink throws them away.
+class resultSink {
+public:
+  virtual ~resultSink() = default;
+  // size is the number of unknowns, points is how many points are expected (0 if not known)
+  virtual void begin(int /*size*/, int /*points*/) {}
+  // x has size entries
+  virtual void add(double t, const std::vector<double>& x) = 0;
+  virtual void end() {}
+};
+
+// An unknown that is kept, with every decimation-th point stored (the first point is always stored)
+struct probe {
+  int row;
+  int decimation = 1;
+};
+
+// The points in memory, one row matrix per unknown. This is the layout the solvers
+// have always returned, so take() gives it back without reformatting anything.
+// With probes only those unknowns are stored and the rest are left empty, time always has every point
+class columnStoreSink : public resultSink {
+public:
+  columnStoreSink() {}
+  columnStoreSink(const std::vector<probe>& probes) : probes(probes), storeAll(false) {}
+
+  std::vector<double> time;
+  std::vector<matrix<double>> columns;
+
+  void begin(int size, int points) override;
+  void add(double t, const std::vector<double>& x) override;
+  std::pair<std::vector<double>, std::vector<matrix<double>>> take();
+
+private:
+  std::vector<probe> probes;
+  bool storeAll = true;
+  int pointCount = 0;
+};
+
+// SPICE raw files, the binary layout ngspice writes: a text header naming each vector and its
+// type, then "Binary:" and every point as one native (little endian) double per vector.
+// The first name is the scale (time or frequency). A file can hold several plots one after another.
+// Returns where the number of points is written, so it can be changed with writeRawPoints once it is known
+std::streampos writeRawHeader(std::ostream& file, const std::string& title, const std::string& plotName,
+                              const std::vector<std::string>& names, const std::vector<std::string>& types, int points);
+void writeRawPoints(std::ostream& file, std::streampos location, int points);
+
+// Streams the points to a SPICE raw file, the time then the unknowns named names.
+// Only bufferPoints points are held at a time, the number of points is filled in by end()
+class rawSink : public resultSink {
+public:
+  rawSink(const std::string& fileName, const std::string& title, const std::vector<std::string>& names,
+          const std::vector<std::string>& types, int bufferPoints = 1024);
+  ~rawSink();
+
+  void begin(int size, int points) override;
+  void add(double t, const std::vector<double>& x) override;
+  void end() override;
+  int points() const { return pointCount; }
+  bool isOpen() const { return file.is_open(); }
+
+private:
+  std::ofstream file;
+  std::string title;
+  std::vector<std::string> names, types;
+  std::vector<double> buffer;
+  int bufferPoints;
+  int pointCount = 0;
+  std::streampos pointsLocation = -1;
+  void flush();
+};
+
+// Does nothing with the points, for timing the solver or when only the final state is wanted
+class nullSink : public resultSink {
+public:
+  void add(double, const std::vector<double>&) override { pointCount++; }
+  int points() const { return pointCount; }
+
+private:
+  int pointCount = 0;
+};
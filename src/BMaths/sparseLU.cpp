@@ -0,0 +1,319 @@
+#include "sparseLU.h"
+#include "ordering.h"
+#include <cmath>
+
+sparseLU::ordering sparseLU::defaultOrdering = sparseLU::MINIMUM_DEGREE;
+
+sparseLU::sparseLU(const sparseMatrix<double>& A) {
+  factor(A);
+}
+
+int sparseLU::nonZeros() const {
+  return Lx.size() + Ux.size() + Ox.size();
+}
+
+// Only redone when the pattern changes, the values do not matter to the orders
+void sparseLU::updateOrdering(const sparseMatrix<double>& A) {
+  if ((int)rowOrder.size() == A.rows && orderedWith == order && orderedBlockTriangular == blockTriangular &&
+      orderedRowStart == A.rowStart && orderedColIdx == A.colIdx) {
+    return;
+  }
+  int size = A.rows;
+  blockTriangularForm form;
+  // A structurally singular matrix is left as one block, factor() then finds the zero pivot
+  if (!blockTriangular || !findBlockTriangularForm(A, form)) {
+    form.rowOrder = createIdxRange(size);
+    form.colOrder = createIdxRange(size);
+    form.blockStart = {0, size};
+  }
+  rowOrder = form.rowOrder;
+  colOrder = form.colOrder;
+  blockStart = form.blockStart;
+  rowInv.assign(size, 0);
+  colInv.assign(size, 0);
+  for (int k = 0; k < size; k++) {
+    rowInv[rowOrder[k]] = k;
+    colInv[colOrder[k]] = k;
+  }
+
+  // The same order is used for the rows and cols of a block, so the matched entries stay on the diagonal
+  if (order != NATURAL) {
+    auto blocks = permute(A);
+    for (int b = 0; b + 1 < (int)blockStart.size(); b++) {
+      int first = blockStart[b];
+      int last = blockStart[b + 1];
+      // Blocks of one or two fill in the same whatever the order
+      if (last - first < 3) {
+        continue;
+      }
+      sparseMatrix<double> block;
+      block.rows = block.cols = last - first;
+      block.rowStart = {0};
+      for (int row = first; row < last; row++) {
+        for (int p = blocks.rowStart[row]; p < blocks.rowStart[row + 1]; p++) {
+          if (blocks.colIdx[p] >= first && blocks.colIdx[p] < last) {
+            block.colIdx.push_back(blocks.colIdx[p] - first);
+            block.values.push_back(blocks.values[p]);
+          }
+        }
+        block.rowStart.push_back(block.colIdx.size());
+      }
+      auto inner = (order == REVERSE_CUTHILL_MCKEE) ? reverseCuthillMcKeeOrdering(block) : minimumDegreeOrdering(block);
+      for (int k = 0; k < block.rows; k++) {
+        rowOrder[first + k] = form.rowOrder[first + inner[k]];
+        colOrder[first + k] = form.colOrder[first + inner[k]];
+      }
+    }
+    for (int k = 0; k < size; k++) {
+      rowInv[rowOrder[k]] = k;
+      colInv[colOrder[k]] = k;
+    }
+  }
+  orderedRowStart = A.rowStart;
+  orderedColIdx = A.colIdx;
+  orderedWith = order;
+  orderedBlockTriangular = blockTriangular;
+}
+
+// A(rowOrder, colOrder), built straight into the CSR arrays
+sparseMatrix<double> sparseLU::permute(const sparseMatrix<double>& A) const {
+  sparseMatrix<double> output;
+  output.rows = A.rows;
+  output.cols = A.cols;
+  output.rowStart.assign(A.rows + 1, 0);
+  output.colIdx.resize(A.colIdx.size());
+  output.values.resize(A.values.size());
+  std::vector<std::pair<int, double>> entries;
+  int next = 0;
+  for (int row = 0; row < A.rows; row++) {
+    int from = rowOrder[row];
+    entries.clear();
+    for (int p = A.rowStart[from]; p < A.rowStart[from + 1]; p++) {
+      entries.push_back({colInv[A.colIdx[p]], A.values[p]});
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+      return a.first < b.first;
+    });
+    for (const auto& [col, value] : entries) {
+      output.colIdx[next] = col;
+      output.values[next] = value;
+      next++;
+    }
+    output.rowStart[row + 1] = next;
+  }
+  return output;
+}
+
+// Find the rows of L that will be non zero when solving L x = A(:,col),
+// they are returned in xi[top..n-1] in topological order.
+// Rows above first belong to the blocks above and are left out
+int sparseLU::reach(const sparseMatrix<double>& Acsc, int col, int first, std::vector<int>& xi, std::vector<int>& stack, std::vector<int>& mark, int markValue) {
+  int top = n;
+  std::vector<int>& pstack = stack; // second half of stack is used for the positions
+  for (int p = Acsc.rowStart[col]; p < Acsc.rowStart[col + 1]; p++) {
+    int start = Acsc.colIdx[p];
+    if (start < first || mark[start] == markValue) {
+      continue;
+    }
+    int head = 0;
+    stack[0] = start;
+    while (head >= 0) {
+      int j = stack[head];
+      int jnew = pinv[j];
+      if (mark[j] != markValue) {
+        mark[j] = markValue;
+        pstack[n + head] = (jnew < 0) ? 0 : Lp[jnew] + 1; // skip the unit diagonal
+      }
+      bool done = true;
+      int pEnd = (jnew < 0) ? 0 : Lp[jnew + 1];
+      for (int q = pstack[n + head]; q < pEnd; q++) {
+        int i = Li[q];
+        if (mark[i] == markValue) {
+          continue;
+        }
+        pstack[n + head] = q + 1;
+        stack[++head] = i;
+        done = false;
+        break;
+      }
+      if (done) {
+        head--;
+        xi[--top] = j;
+      }
+    }
+  }
+  return top;
+}
+
+void sparseLU::factor(const sparseMatrix<double>& A) {
+  if (A.rows != A.cols) {
+    std::cerr << "ERROR: Sparse LU needs a square matrix" << std::endl;
+    return;
+  }
+  if (!A.isCompressed()) {
+    std::cerr << "ERROR: Sparse matrix must be compressed before factoring" << std::endl;
+    return;
+  }
+  n = A.rows;
+  isFactored = false;
+  isSingular = false;
+  updateOrdering(A);
+  auto blocks = permute(A);
+  auto Acsc = blocks.transpose();
+
+  // The parts above the diagonal blocks are kept as they are for the back substitution
+  Op.assign(n + 1, 0);
+  Oi.clear(); Ox.clear();
+  for (int b = 0; b + 1 < (int)blockStart.size(); b++) {
+    int last = blockStart[b + 1];
+    for (int row = blockStart[b]; row < last; row++) {
+      for (int p = blocks.rowStart[row]; p < blocks.rowStart[row + 1]; p++) {
+        if (blocks.colIdx[p] >= last) {
+          Oi.push_back(blocks.colIdx[p]);
+          Ox.push_back(blocks.values[p]);
+        }
+      }
+      Op[row + 1] = Oi.size();
+    }
+  }
+
+  Lp.assign(n + 1, 0);
+  Up.assign(n + 1, 0);
+  Li.clear(); Lx.clear(); Ui.clear(); Ux.clear();
+  Li.reserve(A.nonZeros() * 2 + n);
+  Lx.reserve(A.nonZeros() * 2 + n);
+  Ui.reserve(A.nonZeros() * 2 + n);
+  Ux.reserve(A.nonZeros() * 2 + n);
+  pinv.assign(n, -1);
+
+  std::vector<double> x(n, 0.0);
+  std::vector<int> xi(n), stack(2 * n), mark(n, 0);
+
+  int block = 0;
+  for (int k = 0; k < n; k++) {
+    Lp[k] = Li.size();
+    Up[k] = Ui.size();
+    if (k == blockStart[block + 1]) {
+      block++;
+    }
+    int first = blockStart[block];
+
+    // x = L \ A(:,k), only the rows in this block
+    int top = reach(Acsc, k, first, xi, stack, mark, k + 1);
+    for (int p = Acsc.rowStart[k]; p < Acsc.rowStart[k + 1]; p++) {
+      if (Acsc.colIdx[p] >= first) {
+        x[Acsc.colIdx[p]] = Acsc.values[p];
+      }
+    }
+    for (int px = top; px < n; px++) {
+      int j = xi[px];
+      int J = pinv[j];
+      if (J < 0) {
+        continue;
+      }
+      for (int p = Lp[J] + 1; p < Lp[J + 1]; p++) {
+        x[Li[p]] -= Lx[p] * x[j];
+      }
+    }
+
+    // Pick the pivot from the rows that have not been used yet
+    int ipiv = -1;
+    double largest = -1.0;
+    for (int px = top; px < n; px++) {
+      int i = xi[px];
+      if (pinv[i] < 0) {
+        if (std::abs(x[i]) > largest) {
+          largest = std::abs(x[i]);
+          ipiv = i;
+        }
+      } else {
+        Ui.push_back(pinv[i]);
+        Ux.push_back(x[i]);
+      }
+    }
+    if (ipiv == -1 || largest <= 0.0) {
+      std::cerr << "ERROR: matrix is singular" << std::endl;
+      isSingular = true;
+      for (int px = top; px < n; px++) {
+        x[xi[px]] = 0.0;
+      }
+      return;
+    }
+    if (pinv[k] < 0 && mark[k] == k + 1 && std::abs(x[k]) >= largest * pivotTolerance) {
+      ipiv = k;
+    }
+
+    double pivot = x[ipiv];
+    Ui.push_back(k);
+    Ux.push_back(pivot);
+    pinv[ipiv] = k;
+    Li.push_back(ipiv);
+    Lx.push_back(1.0);
+    for (int px = top; px < n; px++) {
+      int i = xi[px];
+      if (pinv[i] < 0) {
+        Li.push_back(i);
+        Lx.push_back(x[i] / pivot);
+      }
+      x[i] = 0.0;
+    }
+  }
+  Lp[n] = Li.size();
+  Up[n] = Ui.size();
+  for (auto& i : Li) {
+    i = pinv[i];
+  }
+  isFactored = true;
+}
+
+void sparseLU::solveInPlace(std::vector<double>& b) const {
+  if (!isFactored) {
+    std::cerr << "ERROR: Sparse LU has not been factored" << std::endl;
+    return;
+  }
+  std::vector<double> y(n), x(n);
+  for (int k = 0; k < n; k++) {
+    y[k] = b[rowOrder[k]];
+  }
+  // Bottom block first, each block takes off what the blocks below it give then solves its L U
+  for (int block = (int)blockStart.size() - 2; block >= 0; block--) {
+    int first = blockStart[block];
+    int last = blockStart[block + 1];
+    for (int i = first; i < last; i++) {
+      double sum = y[i];
+      for (int p = Op[i]; p < Op[i + 1]; p++) {
+        sum -= Ox[p] * x[Oi[p]];
+      }
+      x[pinv[i]] = sum;
+    }
+    for (int j = first; j < last; j++) {
+      for (int p = Lp[j] + 1; p < Lp[j + 1]; p++) {
+        x[Li[p]] -= Lx[p] * x[j];
+      }
+    }
+    for (int j = last - 1; j >= first; j--) {
+      x[j] /= Ux[Up[j + 1] - 1];
+      for (int p = Up[j]; p < Up[j + 1] - 1; p++) {
+        x[Ui[p]] -= Ux[p] * x[j];
+      }
+    }
+  }
+  for (int k = 0; k < n; k++) {
+    b[colOrder[k]] = x[k];
+  }
+}
+
+matrix<double> sparseLU::solve(const matrix<double>& b) const {
+  matrix<double> output = b;
+  std::vector<double> column(b.rows);
+  for (int col = 0; col < b.cols; col++) {
+    for (int row = 0; row < b.rows; row++) {
+      column[row] = b[row][col];
+    }
+    solveInPlace(column);
+    for (int row = 0; row < b.rows; row++) {
+      output[row][col] = column[row];
+    }
+  }
+  return output;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include "matrix.h"
+#include "sparseMatrix.h"
+
+// Sparse LU factorization with partial pivoting, P A = L U.
+// This is a left looking (Gilbert-Peierls) factorization, each column of L and U
+// is found with a sparse triangular solve so the work depends on the non zeros
+// and not on the size of the matrix.
+// Like KLU the matrix is first put in block triangular form, circuits split into a lot of
+// blocks (the GND row, voltage source branches, opamp outputs) and only the blocks on the
+// diagonal are factored. Inside each block the rows and cols are reordered to cut down the fill in.
+// The orders are worked out once for a pattern and kept while the pattern stays the same.
+// solve() takes and gives back b and x in the order of A.
+class sparseLU {
+public:
+  enum ordering {NATURAL, REVERSE_CUTHILL_MCKEE, MINIMUM_DEGREE};
+  // Used by every sparseLU made after it is set
+  static ordering defaultOrdering;
+
+  sparseLU() {};
+  sparseLU(const sparseMatrix<double>& A);
+
+  void factor(const sparseMatrix<double>& A);
+  matrix<double> solve(const matrix<double>& b) const;
+  void solveInPlace(std::vector<double>& x) const;
+
+  bool isFactored = false;
+  bool isSingular = false;
+  int n = 0;
+  int nonZeros() const;
+
+  // Prefer the diagonal as the pivot if it is within this fraction of the largest entry
+  double pivotTolerance = 0.1;
+  ordering order = defaultOrdering;
+  // Off factors the whole matrix as one block
+  bool blockTriangular = true;
+
+private:
+  // L and U are stored by column
+  std::vector<int> Lp, Li, Up, Ui;
+  std::vector<double> Lx, Ux;
+  std::vector<int> pinv; // row i of A is row pinv[i] of L U
+
+  // Row k of the factored matrix is rowOrder[k] of A and col k is colOrder[k], rowInv and colInv go the other way
+  std::vector<int> rowOrder, colOrder, rowInv, colInv;
+  // Block b is rows and cols blockStart[b] to blockStart[b + 1] - 1 of the factored matrix
+  std::vector<int> blockStart;
+  // The entries right of the diagonal blocks, by row
+  std::vector<int> Op, Oi;
+  std::vector<double> Ox;
+  // The pattern the orders were worked out for
+  std::vector<int> orderedRowStart, orderedColIdx;
+  ordering orderedWith = NATURAL;
+  bool orderedBlockTriangular = false;
+
+  void updateOrdering(const sparseMatrix<double>& A);
+  sparseMatrix<double> permute(const sparseMatrix<double>& A) const;
+
+  int reach(const sparseMatrix<double>& Acsc, int col, int first, std::vector<int>& xi, std::vector<int>& stack, std::vector<int>& mark, int markValue);
+};
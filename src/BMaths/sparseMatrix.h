@@ -0,0 +1,299 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <iomanip>
+#include "matrix.h"
+
+// Compressed sparse row (CSR) matrix.
+// While a circuit is being stamped the entries live in small per row lists so
+// that adding a new entry is cheap, compress() then packs them into the CSR arrays.
+// Calling at() on an entry that is not in the pattern will reopen the stamping lists.
+template <typename T>
+class sparseMatrix {
+ public:
+  int cols = 0, rows = 0;
+  std::vector<int> rowStart; // rows + 1 entries
+  std::vector<int> colIdx;
+  std::vector<T> values;
+
+  void createData();
+  void print(const std::string name = "") const;
+
+  T& at(int row, int col);
+  T get(int row, int col) const;
+  void compress();
+  bool isCompressed() const { return compressed; };
+  int nonZeros() const;
+  bool rowIsEmpty(int row) const;
+  std::vector<int> nonEmptyRows() const;
+  std::vector<int> nonEmptyCols() const;
+
+  sparseMatrix<T> getSubMatrix(const std::vector<int>& rowIdx, const std::vector<int>& colIdx) const;
+  sparseMatrix<T> transpose() const;
+  matrix<T> toDense() const;
+
+  matrix<T> operator*(const matrix<T>& other) const;
+
+ private:
+  bool compressed = true;
+  std::vector<std::vector<std::pair<int, T>>> stampRows;
+  void decompress();
+};
+
+template <typename T>
+sparseMatrix<T> createSparseFromDense(const matrix<T>& input) {
+  sparseMatrix<T> output;
+  output.rows = input.rows;
+  output.cols = input.cols;
+  output.rowStart = std::vector<int>(input.rows + 1, 0);
+  for (int row = 0; row < input.rows; row++) {
+    for (int col = 0; col < input.cols; col++) {
+      if (input[row][col] != 0.0) {
+        output.colIdx.push_back(col);
+        output.values.push_back(input[row][col]);
+      }
+    }
+    output.rowStart[row + 1] = output.colIdx.size();
+  }
+  return output;
+}
+
+template <typename T>
+void sparseMatrix<T>::createData() {
+  rowStart = std::vector<int>(rows + 1, 0);
+  colIdx.clear();
+  values.clear();
+  stampRows.clear();
+  compressed = true;
+}
+
+template <typename T>
+void sparseMatrix<T>::print(const std::string name) const {
+  if (name != "") std::cout << name << std::endl;
+  if (!compressed) {
+    std::cerr << "ERROR: Sparse matrix must be compressed before printing" << std::endl;
+    return;
+  }
+  std::cout << rows << "x" << cols << " with " << nonZeros() << " non zeros" << std::endl;
+  for (int row = 0; row < rows; row++) {
+    for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+      std::cout << "(" << row << ", " << colIdx[p] << ") "
+                << std::scientific << std::setprecision(5) << values[p] << std::endl;
+    }
+  }
+  std::cout << "\n";
+}
+
+template <typename T>
+void sparseMatrix<T>::decompress() {
+  stampRows = std::vector<std::vector<std::pair<int, T>>>(rows);
+  if (rowStart.size() == (size_t)rows + 1) {
+    for (int row = 0; row < rows; row++) {
+      for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+        stampRows[row].push_back({colIdx[p], values[p]});
+      }
+    }
+  }
+  compressed = false;
+}
+
+// Used for stamping, the entry is created if it does not exist yet
+template <typename T>
+T& sparseMatrix<T>::at(int row, int col) {
+  if (row < 0 || row >= rows || col < 0 || col >= cols) {
+    std::cerr << "ERROR: Sparse index (" << row << ", " << col << ") is out of bounds" << std::endl;
+  }
+  if (compressed) {
+    auto begin = colIdx.begin() + rowStart[row];
+    auto end = colIdx.begin() + rowStart[row + 1];
+    auto it = std::lower_bound(begin, end, col);
+    if (it != end && *it == col) {
+      return values[it - colIdx.begin()];
+    }
+    decompress();
+  }
+  for (auto& entry : stampRows[row]) {
+    if (entry.first == col) {
+      return entry.second;
+    }
+  }
+  stampRows[row].push_back({col, T(0)});
+  return stampRows[row].back().second;
+}
+
+template <typename T>
+T sparseMatrix<T>::get(int row, int col) const {
+  if (!compressed) {
+    for (auto& entry : stampRows[row]) {
+      if (entry.first == col) {
+        return entry.second;
+      }
+    }
+    return T(0);
+  }
+  auto begin = colIdx.begin() + rowStart[row];
+  auto end = colIdx.begin() + rowStart[row + 1];
+  auto it = std::lower_bound(begin, end, col);
+  if (it != end && *it == col) {
+    return values[it - colIdx.begin()];
+  }
+  return T(0);
+}
+
+// Pack the stamped entries into CSR, entries that ended up as zero are kept
+// so that the pattern does not change when a component value changes
+template <typename T>
+void sparseMatrix<T>::compress() {
+  if (compressed) {
+    return;
+  }
+  rowStart = std::vector<int>(rows + 1, 0);
+  colIdx.clear();
+  values.clear();
+  for (int row = 0; row < rows; row++) {
+    auto& entries = stampRows[row];
+    std::sort(entries.begin(), entries.end(), [](auto& a, auto& b) { return a.first < b.first; });
+    for (auto& entry : entries) {
+      colIdx.push_back(entry.first);
+      values.push_back(entry.second);
+    }
+    rowStart[row + 1] = colIdx.size();
+  }
+  stampRows.clear();
+  compressed = true;
+}
+
+template <typename T>
+int sparseMatrix<T>::nonZeros() const {
+  return values.size();
+}
+
+template <typename T>
+bool sparseMatrix<T>::rowIsEmpty(int row) const {
+  for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+    if (values[p] != 0.0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+std::vector<int> sparseMatrix<T>::nonEmptyRows() const {
+  std::vector<int> output;
+  for (int row = 0; row < rows; row++) {
+    if (!rowIsEmpty(row)) {
+      output.push_back(row);
+    }
+  }
+  return output;
+}
+
+template <typename T>
+std::vector<int> sparseMatrix<T>::nonEmptyCols() const {
+  std::vector<bool> isUsed(cols, false);
+  for (int p = 0; p < (int)values.size(); p++) {
+    if (values[p] != 0.0) {
+      isUsed[colIdx[p]] = true;
+    }
+  }
+  std::vector<int> output;
+  for (int col = 0; col < cols; col++) {
+    if (isUsed[col]) {
+      output.push_back(col);
+    }
+  }
+  return output;
+}
+
+// Gather the rows and cols in the given order, the output is compressed
+template <typename T>
+sparseMatrix<T> sparseMatrix<T>::getSubMatrix(const std::vector<int>& rowIdx, const std::vector<int>& colIdxIn) const {
+  std::vector<int> colMap(cols, -1);
+  for (int i = 0; i < (int)colIdxIn.size(); i++) {
+    colMap[colIdxIn[i]] = i;
+  }
+  sparseMatrix<T> output;
+  output.rows = rowIdx.size();
+  output.cols = colIdxIn.size();
+  output.rowStart = std::vector<int>(output.rows + 1, 0);
+  std::vector<std::pair<int, T>> rowEntries;
+  for (int i = 0; i < output.rows; i++) {
+    rowEntries.clear();
+    int row = rowIdx[i];
+    for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+      if (colMap[colIdx[p]] >= 0) {
+        rowEntries.push_back({colMap[colIdx[p]], values[p]});
+      }
+    }
+    std::sort(rowEntries.begin(), rowEntries.end(), [](auto& a, auto& b) { return a.first < b.first; });
+    for (auto& entry : rowEntries) {
+      output.colIdx.push_back(entry.first);
+      output.values.push_back(entry.second);
+    }
+    output.rowStart[i + 1] = output.colIdx.size();
+  }
+  return output;
+}
+
+// The CSR of the transpose is the compressed sparse column form of the input
+template <typename T>
+sparseMatrix<T> sparseMatrix<T>::transpose() const {
+  sparseMatrix<T> output;
+  output.rows = cols;
+  output.cols = rows;
+  output.rowStart = std::vector<int>(cols + 1, 0);
+  output.colIdx = std::vector<int>(values.size());
+  output.values = std::vector<T>(values.size());
+  for (auto col : colIdx) {
+    output.rowStart[col + 1]++;
+  }
+  for (int col = 0; col < cols; col++) {
+    output.rowStart[col + 1] += output.rowStart[col];
+  }
+  std::vector<int> next(output.rowStart.begin(), output.rowStart.end() - 1);
+  for (int row = 0; row < rows; row++) {
+    for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+      int q = next[colIdx[p]]++;
+      output.colIdx[q] = row;
+      output.values[q] = values[p];
+    }
+  }
+  return output;
+}
+
+template <typename T>
+matrix<T> sparseMatrix<T>::toDense() const {
+  matrix<T> output;
+  output.rows = rows;
+  output.cols = cols;
+  output.createData();
+  for (int row = 0; row < rows; row++) {
+    for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+      output[row][colIdx[p]] = values[p];
+    }
+  }
+  return output;
+}
+
+template <typename T>
+matrix<T> sparseMatrix<T>::operator*(const matrix<T>& other) const {
+  if (cols != other.rows) {
+    std::cerr << "ERROR: For multiply cols of A must be equal to rows of B" << std::endl;
+  }
+  matrix<T> output;
+  output.rows = rows;
+  output.cols = other.cols;
+  output.createData();
+  for (int row = 0; row < rows; row++) {
+    for (int p = rowStart[row]; p < rowStart[row + 1]; p++) {
+      for (int col = 0; col < other.cols; col++) {
+        output[row][col] += values[p] * other[colIdx[p]][col];
+      }
+    }
+  }
+  return output;
+}
@@ -0,0 +1,122 @@
+#include "threadPool.h"
+#include <algorithm>
+
+// The pool the current thread works for, if it is a worker
+static thread_local const threadPool* workerOf = nullptr;
+
+threadPool::threadPool(int threads) {
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (int i = 0; i < threads; i++) {
+    queues.push_back(std::make_unique<workQueue>());
+  }
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back(&threadPool::run, this, i);
+  }
+}
+
+threadPool::~threadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void threadPool::submit(std::function<void()> task) {
+  pending++;
+  auto& queue = *queues[nextQueue++ % queues.size()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    queued++;
+  }
+  wake.notify_one();
+}
+
+bool threadPool::isWorkerThread() const {
+  return workerOf == this;
+}
+
+void threadPool::wait() {
+  std::unique_lock<std::mutex> lock(sleepMutex);
+  done.wait(lock, [&] { return pending == 0; });
+}
+
+bool threadPool::tryPop(int worker, std::function<void()>& task) {
+  // Own queue first, newest task
+  {
+    auto& queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      queued--;
+      return true;
+    }
+  }
+  // Then steal the oldest task from the others
+  for (int i = 1; i < (int)queues.size(); i++) {
+    auto& queue = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void threadPool::run(int worker) {
+  workerOf = this;
+  std::function<void()> task;
+  while (true) {
+    if (tryPop(worker, task)) {
+      task();
+      task = nullptr;
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        done.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    wake.wait(lock, [&] { return stopping || queued > 0; });
+    if (stopping && queued == 0) {
+      return;
+    }
+  }
+}
+
+void parallelFor(threadPool& pool, int count, const std::function<void(int)>& body) {
+  if (pool.isWorkerThread()) {
+    for (int i = 0; i < count; i++) {
+      body(i);
+    }
+    return;
+  }
+  std::mutex mutex;
+  std::condition_variable finished;
+  int left = count;
+  for (int i = 0; i < count; i++) {
+    pool.submit([&, i] {
+      body(i);
+      // Notified with the lock held so this call can not return and take mutex with it first
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--left == 0) {
+        finished.notify_all();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&] { return left == 0; });
+}
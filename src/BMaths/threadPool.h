@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+// A fixed set of worker threads, each with its own queue of tasks.
+// Tasks are handed out to the queues in turn. A worker takes the newest task
+// from its own queue, and when that is empty it steals the oldest task from
+// another queue, so long and short tasks still even out over the workers.
+class threadPool {
+public:
+  // threads <= 0 uses one thread per core
+  threadPool(int threads = 0);
+  ~threadPool();
+  threadPool(const threadPool&) = delete;
+  threadPool& operator=(const threadPool&) = delete;
+
+  void submit(std::function<void()> task);
+  // Blocks until every task that has been submitted has finished, by anyone
+  void wait();
+  int size() const { return workers.size(); };
+  // True on the threads of this pool, so inside one of its tasks
+  bool isWorkerThread() const;
+
+private:
+  struct workQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+  std::vector<std::unique_ptr<workQueue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<unsigned> nextQueue{0};
+  std::atomic<int> queued{0};  // in the queues
+  std::atomic<int> pending{0}; // queued or running
+  bool stopping = false;
+  std::mutex sleepMutex;
+  std::condition_variable wake, done;
+
+  bool tryPop(int worker, std::function<void()>& task);
+  void run(int worker);
+};
+
+// Calls body(i) for every i in [0, count) on the pool and waits for them all.
+// Only these calls are waited on, so several threads can share a pool. From inside a
+// task of the same pool the calls are made in turn on that thread, waiting there could
+// leave no worker free to run them
+void parallelFor(threadPool& pool, int count, const std::function<void(int)>& body);
@@ -0,0 +1,191 @@
+#include "vectorKernels.h"
+#include "blockedKernels.h"
+#include <cmath>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VECTOR_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+double dotScalar(const double* x, const double* y, int n) {
+  double sum = 0.0;
+  for (int i = 0; i < n; i++) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+void axpyScalar(double a, const double* x, double* y, int n) {
+  for (int i = 0; i < n; i++) {
+    y[i] += a * x[i];
+  }
+}
+
+#ifdef VECTOR_KERNELS_X86
+// Two accumulators so the adds do not wait on each other
+__attribute__((target("sse2")))
+double dotSSE2(const double* x, const double* y, int n) {
+  __m128d sum0 = _mm_setzero_pd();
+  __m128d sum1 = _mm_setzero_pd();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+    sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+  }
+  sum0 = _mm_add_pd(sum0, sum1);
+  double parts[2];
+  _mm_storeu_pd(parts, sum0);
+  double sum = parts[0] + parts[1];
+  for (; i < n; i++) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+__attribute__((target("sse2")))
+void axpySSE2(double a, const double* x, double* y, int n) {
+  __m128d va = _mm_set1_pd(a);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+  }
+  for (; i < n; i++) {
+    y[i] += a * x[i];
+  }
+}
+
+__attribute__((target("avx2,fma")))
+double dotAVX2(const double* x, const double* y, int n) {
+  __m256d sum0 = _mm256_setzero_pd();
+  __m256d sum1 = _mm256_setzero_pd();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), sum0);
+    sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), sum1);
+  }
+  if (i + 4 <= n) {
+    sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), sum0);
+    i += 4;
+  }
+  sum0 = _mm256_add_pd(sum0, sum1);
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum0), _mm256_extractf128_pd(sum0, 1));
+  double parts[2];
+  _mm_storeu_pd(parts, half);
+  double sum = parts[0] + parts[1];
+  for (; i < n; i++) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+__attribute__((target("avx2,fma")))
+void axpyAVX2(double a, const double* x, double* y, int n) {
+  __m256d va = _mm256_set1_pd(a);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+  }
+  for (; i < n; i++) {
+    y[i] += a * x[i];
+  }
+}
+#endif
+
+struct kernels {
+  std::string name;
+  double (*dot)(const double*, const double*, int);
+  void (*axpy)(double, const double*, double*, int);
+};
+
+const kernels scalarKernels = {"scalar", dotScalar, axpyScalar};
+#ifdef VECTOR_KERNELS_X86
+const kernels sse2Kernels = {"sse2", dotSSE2, axpySSE2};
+const kernels avx2Kernels = {"avx2", dotAVX2, axpyAVX2};
+#endif
+
+bool isSupported(const std::string& name) {
+  if (name == "scalar") {
+    return true;
+  }
+#ifdef VECTOR_KERNELS_X86
+  __builtin_cpu_init();
+  if (name == "sse2") {
+    return __builtin_cpu_supports("sse2");
+  }
+  if (name == "avx2") {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  }
+#endif
+  return false;
+}
+
+const kernels* byName(const std::string& name) {
+#ifdef VECTOR_KERNELS_X86
+  if (name == "avx2") return &avx2Kernels;
+  if (name == "sse2") return &sse2Kernels;
+#endif
+  return &scalarKernels;
+}
+
+const kernels*& active() {
+  static const kernels* selected = isSupported("avx2") ? byName("avx2") : isSupported("sse2") ? byName("sse2") : &scalarKernels;
+  return selected;
+}
+
+}
+
+double dot(const double* x, const double* y, int n) {
+  return active()->dot(x, y, n);
+}
+
+void axpy(double a, const double* x, double* y, int n) {
+  active()->axpy(a, x, y, n);
+}
+
+double norm2(const double* x, int n) {
+  return std::sqrt(active()->dot(x, x, n));
+}
+
+void matVec(const double* A, int rows, int cols, const double* x, double* y) {
+  auto k = active();
+  for (int row = 0; row < rows; row++) {
+    y[row] = k->dot(A + row * cols, x, cols);
+  }
+}
+
+// Row by row so B and C are walked along their rows, each row of C is built up from the rows of B.
+// Past 64^3 multiply adds packing the blocks for gemm pays for itself
+void matMul(const double* A, const double* B, double* C, int rows, int inner, int cols) {
+  auto k = active();
+  std::fill(C, C + rows * cols, 0.0);
+  if ((long long)rows * inner * cols >= 64 * 64 * 64) {
+    gemm(rows, inner, cols, 1.0, A, inner, B, cols, C, cols);
+    return;
+  }
+  for (int row = 0; row < rows; row++) {
+    for (int i = 0; i < inner; i++) {
+      double a = A[row * inner + i];
+      if (a != 0.0) {
+        k->axpy(a, B + i * cols, C + row * cols, cols);
+      }
+    }
+  }
+}
+
+std::string vectorKernelName() {
+  return active()->name;
+}
+
+bool selectVectorKernels(const std::string& name) {
+  if (name != "scalar" && name != "sse2" && name != "avx2") {
+    return false;
+  }
+  if (!isSupported(name)) {
+    return false;
+  }
+  active() = byName(name);
+  return true;
+}
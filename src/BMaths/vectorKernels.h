@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+// Dense double kernels for the inner loops of the matrix, LU and Newton code.
+// The AVX2 (with FMA) or SSE2 versions are picked the first time one is called, from
+// what the CPU supports, anything else falls back to plain loops.
+// The vector versions add in a different order so the last bits can differ from the plain loops.
+
+// x . y
+double dot(const double* x, const double* y, int n);
+// y += a x
+void axpy(double a, const double* x, double* y, int n);
+// sqrt(x . x)
+double norm2(const double* x, int n);
+// y = A x, A is rows x cols and row major
+void matVec(const double* A, int rows, int cols, const double* x, double* y);
+// C = A B, A is rows x inner, B is inner x cols and C is rows x cols, all row major
+void matMul(const double* A, const double* B, double* C, int rows, int inner, int cols);
+
+// "avx2", "sse2" or "scalar"
+std::string vectorKernelName();
+// Forces one of the names above, false if this CPU can not run it
+bool selectVectorKernels(const std::string& name);
@@ -0,0 +1,109 @@
+#include "circuit.h"
+#include "fileParser.h"
+#include "tokenParser.h"
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Times DAESolve2 against compiledDAE on each circuit that is passed in, for example:
+// ./benchmark ../Examples/*.circuit
+// The largest difference between the two results is printed so it is easy to see
+// if the compiled stepper has drifted from the reference.
+// --kernels scalar|sse2|avx2 picks the dense vector kernels instead of the best the CPU has.
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double maxDifference(const std::vector<matrix<double>>& a, const std::vector<matrix<double>>& b) {
+  double output = 0.0;
+  if (a.size() != b.size()) {
+    return INFINITY;
+  }
+  for (int row = 0; row < (int)a.size(); row++) {
+    if (a[row].data.size() != b[row].data.size()) {
+      return INFINITY;
+    }
+    for (int i = 0; i < (int)a[row].data.size(); i++) {
+      output = std::max(output, std::abs(a[row].data[i] - b[row].data[i]));
+    }
+  }
+  return output;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <input_file> [<input_file> ...] [--repeat N] [--kernels NAME]" << std::endl;
+    return 1;
+  }
+  std::vector<std::string> inputFiles;
+  int repeat = 1;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--repeat" && i + 1 < argc) {
+      repeat = std::max(1, std::stoi(argv[++i]));
+    } else if (std::string(argv[i]) == "--kernels" && i + 1 < argc) {
+      std::string name = argv[++i];
+      if (!selectVectorKernels(name)) {
+        std::cerr << "ERROR: `" << name << "` kernels can not be used, use scalar, sse2 or avx2" << std::endl;
+      }
+    } else {
+      inputFiles.push_back(argv[i]);
+    }
+  }
+
+  std::cout << "Vector kernels: " << vectorKernelName() << std::endl;
+  std::cout << std::left << std::setw(36) << "circuit" << std::right
+            << std::setw(10) << "unknowns" << std::setw(10) << "steps"
+            << std::setw(14) << "DAESolve2 s" << std::setw(14) << "compiled s"
+            << std::setw(10) << "speedup" << std::setw(14) << "max diff" << std::endl;
+  for (auto& inputFile : inputFiles) {
+    // The parser and circuit print a lot, that is not wanted here
+    std::ostringstream discard;
+    auto oldBuffer = std::cout.rdbuf(discard.rdbuf());
+    fileParser parsedFile(inputFile);
+    auto tokens = parsedFile.tokens;
+    Circuit<double, double, function> circuit = createCircuitFromTokens<double, double, function>(tokens);
+    circuit.calculate();
+    std::cout.rdbuf(oldBuffer);
+
+    DifferentialAlgebraicEquation<double, double, function> DAE = {circuit.A, circuit.E, circuit.f, circuit.syms};
+    if (circuit.useSparse) {
+      DAE.A = circuit.sparseA.toDense();
+      DAE.E = circuit.sparseE.toDense();
+    }
+
+    // A circuit that can not be factored would only print an error on every step
+    std::string name = inputFile.substr(inputFile.find_last_of('/') + 1);
+    auto oldErrorBuffer = std::cerr.rdbuf(discard.rdbuf());
+    bool isSingular = compiledDAE<function>(DAE).isSingular;
+    std::cerr.rdbuf(oldErrorBuffer);
+    if (isSingular) {
+      std::cerr << "ERROR: " << name << " has a singular matrix, it is skipped" << std::endl;
+      continue;
+    }
+
+    std::pair<std::vector<double>, std::vector<matrix<double>>> reference, compiled;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++) {
+      reference = DAESolve2(DAE, circuit.initalValues, circuit.timeStep, circuit.stopTime);
+    }
+    double referenceTime = secondsSince(start) / repeat;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++) {
+      compiledDAE<function> stepper(DAE);
+      compiled = stepper.solve(circuit.initalValues, circuit.timeStep, circuit.stopTime);
+    }
+    double compiledTime = secondsSince(start) / repeat;
+
+    std::cout << std::left << std::setw(36) << name << std::right
+              << std::setw(10) << circuit.syms.rows << std::setw(10) << reference.first.size()
+              << std::fixed << std::setprecision(4)
+              << std::setw(14) << referenceTime << std::setw(14) << compiledTime
+              << std::setprecision(1) << std::setw(9) << referenceTime / compiledTime << "x"
+              << std::scientific << std::setprecision(2) << std::setw(14) << maxDifference(reference.second, compiled.second)
+              << std::defaultfloat << std::endl;
+  }
+  return 0;
+};
@@ -3,8 +3,11 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <unordered_map>
 #include "BMaths/BMaths.h"
 #include "component.h"
+#include "symbolTable.h"
+#include "stampList.h"
 
 template<typename T1, typename T2, typename T3>
 class Circuit{
@@ -18,19 +21,61 @@ public:
   std::vector<std::shared_ptr<Component>> components;
 
   // Data
-  double stopTime, timeStep;
+  double stopTime = 0.0, timeStep = 0.0;
+  integrationMethod method = integrationMethod::FORWARD_EULER;
+  // Set by adaptive{TOLERANCE}{MAX_STEP}, timeStep is then only the output spacing
+  bool isAdaptive = false;
+  double tolerance = 1e-3, maxStep = 0.0;
+  // Set by operating_point{PRINT|SEED}, with SEED the transient starts from it
+  bool findOperatingPoint = false;
+  bool seedFromOperatingPoint = false;
+  // Set by ac{START}{STOP}{POINTS}
+  bool runACSweep = false;
+  double acStart = 0.0, acStop = 0.0;
+  int acPoints = 0;
+  // Set by sweep{COMPONENT}{START}{STOP}{POINTS} and monte_carlo{RUNS}{TOLERANCE}{SEED}
+  struct sweepParameter {
+    std::string componentName;
+    double start, stop;
+    int points;
+  };
+  std::vector<sweepParameter> sweeps;
+  int monteCarloRuns = 0;
+  double monteCarloTolerance = 0.0;
+  unsigned int monteCarloSeed = 1;
   std::vector<double> time;
   matrix<T1> A;
   matrix<T2> E;
   matrix<T3> f;
+  // The small signal phasor of each source, only AC and square wave sources are non zero
+  matrix<complexNumber<double>> acSources;
   matrix<double> initalValues;
   matrix<symbol> syms;
+  // The rows of syms by name and by node
+  symbolTable symbols;
+
+  // Large circuits are stamped straight into sparse storage, A and E are then left empty
+  bool useSparse = false;
+  int sparseThreshold = 500;
+  sparseMatrix<T1> sparseA;
+  sparseMatrix<T2> sparseE;
+  // Everything written into A and E with the 1/R, C or L of each component, A and E can be
+  // made again from this with different values without building the circuit again
+  stampList stamps;
+  static double stampedValue(Component::ComponentType type, double value);
+
+  // The parts that are not linear, they are not in A and are solved with Newton
+  std::vector<std::shared_ptr<nonlinearDevice>> devices;
 
   // Helper functions
   matrix<symbol> removeGroundSym();
 private:
   void generateMatrices();
+  void generateNonlinearDevices();
   std::vector<Node*> findNodeFromComponent(std::shared_ptr<Component> comp);
+  void generateComponentNodes();
+  // The nodes each component is in, by component name, in the order of nodes
+  std::unordered_map<std::string, std::vector<Node*>> componentNodes;
   void generateSymbols();
   void preAllocateMatrixData();
   int findNodeLocationFromNode(Node* node);
@@ -38,6 +83,17 @@ private:
   void generateComponentConections();
   int findEquationLocationFromSymbol(std::string s);
   bool isInSymbols(symbol sym);
+  // What each type of component adds to the row of node
+  using componentConnection = std::pair<std::shared_ptr<Component>, Component::connectionType>;
+  void stampResistor(int row, Node* node, const componentConnection& c);
+  void stampCapacitor(int row, Node* node, const componentConnection& c);
+  void stampInductor(int row, Node* node, const componentConnection& c);
+  void stampVoltageSource(int row, Node* node, const componentConnection& c);
+  void stampOpamp(int row, Node* node, const componentConnection& c);
+  void stampDiode(int row, Node* node, const componentConnection& c);
+  void checkTwoConnections(Component* component, const std::string& typeName);
+  // Adds the stamped value (1/R, C or L) of component to stamps and returns where it is
+  int componentValue(Component* component);
 
   function createVoltageFunction(VoltageSource::functionType& type, std::vector<double>& values);
 
@@ -53,177 +109,209 @@ void Circuit<T1, T2, T3>::calculate() {
   generateSymbols();
   preAllocateMatrixData();
 
+  generateComponentNodes();
   generateComponentConections();
   generateMatrices();
+  generateNonlinearDevices();
 
-  A.print("A:");
-  E.print("E:");
+  if (useSparse) {
+    sparseA.print("A:");
+    sparseE.print("E:");
+  } else {
+    A.print("A:");
+    E.print("E:");
+  }
   f.print("f:");
   syms.print("syms:");
   initalValues.print("Inital Values:");
 }
+// Each node fills in its own row, the components in it add what they need through their stamp function.
+// Everything that goes into A and E is kept in stamps, A and E are then made from it in one go
 template<typename T1, typename T2, typename T3>
 void Circuit<T1, T2, T3>::generateMatrices() {
-  
+  using stampFunction = void (Circuit::*)(int row, Node* node, const componentConnection& c);
+  static const std::unordered_map<Component::ComponentType, stampFunction> stampFunctions = {
+    {Component::ComponentType::RESISTOR, &Circuit::stampResistor},
+    {Component::ComponentType::CAPACITOR, &Circuit::stampCapacitor},
+    {Component::ComponentType::INDUCTOR, &Circuit::stampInductor},
+    {Component::ComponentType::VOLTAGESOURCE, &Circuit::stampVoltageSource},
+    {Component::ComponentType::OPAMP, &Circuit::stampOpamp},
+    {Component::ComponentType::DIODE, &Circuit::stampDiode},
+  };
+
+  stamps.clear();
   int equationNumber = 0;
   for (auto node : nodes) {
     if (node->nodeName == "GND") {
       int GNDLocation = findNodeLocationFromNode(node); // node == GND
-      A.data[equationNumber][GNDLocation] = 1;
+      stamps.set(false, equationNumber, GNDLocation, 1);
     } else {
-      for (auto c : node->components) {
-        switch (c.first->Type) {
-        case Component::ComponentType::RESISTOR: {
-          if (c.first->Connections.size() > 2) {
-            std::cerr << "ERROR: Resistor " << c.first->ComponentName << " has too many connections" << std::endl;
-          } else if (c.first->Connections.size() < 2) {
-            std::cerr << "ERROR: Resistor " << c.first->ComponentName << " has not got enough connections" << std::endl;
-          }
-          
-          int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
-          int componentConnectionIdx2 = findNodeLocationFromNode(c.first->Connections[1]);
-          auto resistor = dynamic_cast<Resistor *>(c.first.get());
-
-          if (node == c.first->Connections[0]) {
-            A.data[equationNumber][componentConnectionIdx1] += 1 / resistor->Resistance;
-            A.data[equationNumber][componentConnectionIdx2] -= 1 / resistor->Resistance;
-          } else {
-            A.data[equationNumber][componentConnectionIdx1] -= 1 / resistor->Resistance;
-            A.data[equationNumber][componentConnectionIdx2] += 1 / resistor->Resistance;
-          }
-          break;
-        }
-        case Component::ComponentType::CAPACITOR: {
-          if (c.first->Connections.size() > 2) {
-            std::cerr << "ERROR: Capacitor " << c.first->ComponentName << " has too many connections" << std::endl;
-          } else if (c.first->Connections.size() < 2) {
-            std::cerr << "ERROR: Capacitor " << c.first->ComponentName << " has not got enough connections" << std::endl;
-          }
-          
-          int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
-          int componentConnectionIdx2 = findNodeLocationFromNode(c.first->Connections[1]);
-          auto capacitor = dynamic_cast<Capacitor *>(c.first.get());
-
-          if (node == c.first->Connections[0]) {
-            if (c.first->Connections[0]->nodeName != "GND") {
-              E.data[equationNumber][componentConnectionIdx1] += capacitor->Capacitance;
-            }
-            if (c.first->Connections[1]->nodeName != "GND") {
-              E.data[equationNumber][componentConnectionIdx2] += -capacitor->Capacitance;
-            }
-          } else {
-            if (c.first->Connections[0]->nodeName != "GND") {
-              E.data[equationNumber][componentConnectionIdx1] -= capacitor->Capacitance;
-            }
-            if (c.first->Connections[1]->nodeName != "GND") {
-              E.data[equationNumber][componentConnectionIdx2] -= -capacitor->Capacitance;
-            }
-          }
-          break;
-        }
-        case Component::ComponentType::INDUCTOR: {
-          if (c.first->Connections.size() > 2) {
-            std::cerr << "ERROR: Inductor " << c.first->ComponentName << " has too many connections" << std::endl;
-          } else if (c.first->Connections.size() < 2) {
-            std::cerr << "ERROR: Inductor " << c.first->ComponentName << " has not got enough connections" << std::endl;
-          }
-          
-          int componentCurrentIdx = findNodeLocationFromSymbol("i_" + c.first->ComponentName);
-          int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
-          int componentConnectionIdx2 = findNodeLocationFromNode(c.first->Connections[1]);
-          auto inductor = dynamic_cast<Inductor *>(c.first.get());
-
-          if (node == c.first->Connections[0]) {
-            if (c.first->Connections[0]->nodeName != "GND") {
-              A.data[equationNumber][componentCurrentIdx] += 1;
-            }
-          } else {
-            if (c.first->Connections[0]->nodeName != "GND") {
-              A.data[equationNumber][componentCurrentIdx] -= 1;
-            }
-          }
-          if (node == c.first->Connections[0]) {
-            if (c.first->Connections[0]->nodeName != "GND") {
-              A.data[componentCurrentIdx][componentConnectionIdx1] += 1;
-              E.data[componentCurrentIdx][componentCurrentIdx] -= inductor->Inductance;
-            }
-          } else {
-            if (c.first->Connections[0]->nodeName != "GND") {
-              A.data[componentCurrentIdx][componentConnectionIdx2] -= 1;
-            }
-          }
-          break;
-        }
-        case Component::ComponentType::VOLTAGESOURCE: {
-          int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
-          int componentCurrentIdx = findNodeLocationFromSymbol("i_" + c.first->ComponentName);
-          auto voltageSource = dynamic_cast<VoltageSource *>(c.first.get());
-          A.data[equationNumber][componentCurrentIdx] = 1;
-          A.data[componentCurrentIdx][equationNumber] = 1;
-          if constexpr (std::is_arithmetic<T3>::value) {
-            f.data[componentCurrentIdx][0] += voltageSource->Values[0];
-          }  else if constexpr (std::is_same<T3, function>::value) {
-            f.data[componentCurrentIdx][0] = f.data[componentCurrentIdx][0] + createVoltageFunction(voltageSource->fType, voltageSource->Values);
-          }
-          break;
-        }
-        case Component::ComponentType::OPAMP: {
-          // using:
-          // I_- = I_+ = 0A
-          // Vout = A * (V_+ - V_-)
-          
-          int nodeLocationCurrentP = findNodeLocationFromSymbol("i_" + c.first->ComponentName + "P");
-          int nodeLocationCurrentN = findNodeLocationFromSymbol("i_" + c.first->ComponentName + "N");
-          A.data[nodeLocationCurrentP][nodeLocationCurrentP] = 1;
-          A.data[nodeLocationCurrentN][nodeLocationCurrentN] = 1;
-          
-          auto opamp = dynamic_cast<Opamp *>(c.first.get());
-          auto amp = 100e3; // FIXME: This should be user controlled
-          int nodeLocationVout = -1;
-          for (auto& n : findNodeFromComponent(c.first)) {
-            for (auto& com : n->components) {
-              if (com.second == Component::OPAMP_OUT && c.first->ComponentName == com.first->ComponentName) {
-                nodeLocationVout = findNodeLocationFromNode(n);
-              }
-            }
-          }
-
-          switch (c.second) {
-          case Component::OPAMP_P: {
-            int pos = findNodeLocationFromNode(node);
-            A.data[nodeLocationVout][pos] = -amp;
-            break;
-          }
-          case Component::OPAMP_N: {
-            int pos = findNodeLocationFromNode(node);
-            A.data[nodeLocationVout][pos] = amp;
-            break;
-          }
-          case Component::OPAMP_OUT:{
-            int pos = findNodeLocationFromNode(node);
-            A.data[nodeLocationVout][pos] = 1;
-            break;
-          }
-          default: {
-            std::cerr << "ERROR: Opamp contains the wrong connection type." << std::endl;
-            break;
-          }
-          }
-          break;
-        }
-        case Component::ComponentType::DIODE: {
-          std::cerr << "ERROR: Diodes not done yet" << std::endl;
-          break;
-        }
-        default: {
+      for (auto& c : node->components) {
+        auto it = stampFunctions.find(c.first->Type);
+        if (it == stampFunctions.end()) {
           std::cerr << "ERROR: Component of type: " << c.first->Type << " and name: " << c.first->ComponentName << " was not handled" << std::endl;
+          continue;
         }
-        }
+        (this->*(it->second))(equationNumber, node, c);
       }
-
     }
     equationNumber++;
   }
+
+  if (useSparse) {
+    stamps.createPattern(sparseA, sparseE);
+    sparseA.compress();
+    sparseE.compress();
+    stamps.findSlots(sparseA, sparseE);
+    stamps.apply(sparseA, sparseE, stamps.values);
+  } else {
+    stamps.findSlots(A, E);
+    stamps.apply(A, E, stamps.values);
+  }
+}
+
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::checkTwoConnections(Component* component, const std::string& typeName) {
+  if (component->Connections.size() > 2) {
+    std::cerr << "ERROR: " << typeName << " " << component->ComponentName << " has too many connections" << std::endl;
+  } else if (component->Connections.size() < 2) {
+    std::cerr << "ERROR: " << typeName << " " << component->ComponentName << " has not got enough connections" << std::endl;
+  }
+}
+
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::stampResistor(int row, Node* node, const componentConnection& c) {
+  checkTwoConnections(c.first.get(), "Resistor");
+  int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
+  int componentConnectionIdx2 = findNodeLocationFromNode(c.first->Connections[1]);
+  int value = componentValue(c.first.get());
+  double sign = (node == c.first->Connections[0]) ? 1 : -1;
+  stamps.add(false, row, componentConnectionIdx1, sign, value);
+  stamps.add(false, row, componentConnectionIdx2, -sign, value);
+}
+
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::stampCapacitor(int row, Node* node, const componentConnection& c) {
+  checkTwoConnections(c.first.get(), "Capacitor");
+  int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
+  int componentConnectionIdx2 = findNodeLocationFromNode(c.first->Connections[1]);
+  int value = componentValue(c.first.get());
+  double sign = (node == c.first->Connections[0]) ? 1 : -1;
+  if (c.first->Connections[0]->nodeName != "GND") {
+    stamps.add(true, row, componentConnectionIdx1, sign, value);
+  }
+  if (c.first->Connections[1]->nodeName != "GND") {
+    stamps.add(true, row, componentConnectionIdx2, -sign, value);
+  }
+}
+
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::stampInductor(int row, Node* node, const componentConnection& c) {
+  checkTwoConnections(c.first.get(), "Inductor");
+  int componentCurrentIdx = findNodeLocationFromSymbol("i_" + c.first->ComponentName);
+  int componentConnectionIdx1 = findNodeLocationFromNode(c.first->Connections[0]);
+  int componentConnectionIdx2 = findNodeLocationFromNode(c.first->Connections[1]);
+  int value = componentValue(c.first.get());
+  if (c.first->Connections[0]->nodeName == "GND") {
+    return;
+  }
+  if (node == c.first->Connections[0]) {
+    stamps.add(false, row, componentCurrentIdx, 1);
+    stamps.add(false, componentCurrentIdx, componentConnectionIdx1, 1);
+    stamps.add(true, componentCurrentIdx, componentCurrentIdx, -1, value);
+  } else {
+    stamps.add(false, row, componentCurrentIdx, -1);
+    stamps.add(false, componentCurrentIdx, componentConnectionIdx2, -1);
+  }
+}
+
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::stampVoltageSource(int row, Node*, const componentConnection& c) {
+  int componentCurrentIdx = findNodeLocationFromSymbol("i_" + c.first->ComponentName);
+  auto voltageSource = dynamic_cast<VoltageSource *>(c.first.get());
+  stamps.set(false, row, componentCurrentIdx, 1);
+  stamps.set(false, componentCurrentIdx, row, 1);
+  // The time function and the AC phasor read the magnitude, frequency and phase shift,
+  // a source that is missing them is left at 0V instead of reading past the end of Values
+  bool isTimeVarying = voltageSource->fType != VoltageSource::functionType::NONE;
+  if (voltageSource->Values.size() < (isTimeVarying ? 3u : 1u)) {
+    std::cerr << "ERROR: Voltage source `" << voltageSource->ComponentName << "` is missing values, it is left at 0V." << std::endl;
+    return;
+  }
+  if constexpr (std::is_arithmetic<T3>::value) {
+    f[componentCurrentIdx][0] += voltageSource->Values[0];
+  }  else if constexpr (std::is_same<T3, function>::value) {
+    f[componentCurrentIdx][0] = f[componentCurrentIdx][0] + createVoltageFunction(voltageSource->fType, voltageSource->Values);
+  }
+  if (isTimeVarying) {
+    acSources[componentCurrentIdx][0] += makeComplexNumberFromPolar<double>(voltageSource->Values[0], voltageSource->Values[2]);
+  }
+}
+
+// using:
+// I_- = I_+ = 0A
+// Vout = A * (V_+ - V_-)
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::stampOpamp(int, Node* node, const componentConnection& c) {
+  int nodeLocationCurrentP = findNodeLocationFromSymbol("i_" + c.first->ComponentName + "P");
+  int nodeLocationCurrentN = findNodeLocationFromSymbol("i_" + c.first->ComponentName + "N");
+  stamps.set(false, nodeLocationCurrentP, nodeLocationCurrentP, 1);
+  stamps.set(false, nodeLocationCurrentN, nodeLocationCurrentN, 1);
+
+  auto amp = 100e3; // FIXME: This should be user controlled
+  int nodeLocationVout = -1;
+  for (auto& n : findNodeFromComponent(c.first)) {
+    for (auto& com : n->components) {
+      if (com.second == Component::OPAMP_OUT && c.first->ComponentName == com.first->ComponentName) {
+        nodeLocationVout = findNodeLocationFromNode(n);
+      }
+    }
+  }
+
+  int pos = findNodeLocationFromNode(node);
+  switch (c.second) {
+  case Component::OPAMP_P: {
+    stamps.set(false, nodeLocationVout, pos, -amp);
+    break;
+  }
+  case Component::OPAMP_N: {
+    stamps.set(false, nodeLocationVout, pos, amp);
+    break;
+  }
+  case Component::OPAMP_OUT:{
+    stamps.set(false, nodeLocationVout, pos, 1);
+    break;
+  }
+  default: {
+    std::cerr << "ERROR: Opamp contains the wrong connection type." << std::endl;
+    break;
+  }
+  }
+}
+
+// Nothing linear to stamp, see generateNonlinearDevices()
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::stampDiode(int, Node*, const componentConnection&) {}
+
+template<typename T1, typename T2, typename T3>
+double Circuit<T1, T2, T3>::stampedValue(Component::ComponentType type, double value) {
+  if (type == Component::ComponentType::RESISTOR) {
+    return 1 / value;
+  }
+  return value;
+}
+
+template<typename T1, typename T2, typename T3>
+int Circuit<T1, T2, T3>::componentValue(Component* component) {
+  double value = 0.0;
+  if (auto resistor = dynamic_cast<Resistor *>(component)) {
+    value = resistor->Resistance;
+  } else if (auto capacitor = dynamic_cast<Capacitor *>(component)) {
+    value = capacitor->Capacitance;
+  } else if (auto inductor = dynamic_cast<Inductor *>(component)) {
+    value = inductor->Inductance;
+  }
+  return stamps.addValue(component->ComponentName, stampedValue(component->Type, value));
 }
 
 template<typename T1, typename T2, typename T3>
@@ -260,107 +348,135 @@ function Circuit<T1, T2, T3>::createVoltageFunction(VoltageSource::functionType&
 }
 
 
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::generateComponentNodes() {
+  componentNodes.clear();
+  for (auto node : nodes) {
+    for (auto& c : node->components) {
+      componentNodes[c.first->ComponentName].push_back(node);
+    }
+  }
+}
+
 template<typename T1, typename T2, typename T3>
 std::vector<Node *> Circuit<T1, T2, T3>::findNodeFromComponent(std::shared_ptr<Component> comp1) {
-  std::vector<Node *> nodesWithComponent;
+  auto it = componentNodes.find(comp1->ComponentName);
+  if (it == componentNodes.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+// A diode is found from its + and - connections, ground is -1 so the ground row is left alone
+template<typename T1, typename T2, typename T3>
+void Circuit<T1, T2, T3>::generateNonlinearDevices() {
+  devices.clear();
+  std::vector<std::pair<Diode*, std::pair<int, int>>> diodes;
   for (auto node : nodes) {
-    for (auto comp2 : node->components) {
-      if (comp1->ComponentName == comp2.first->ComponentName) {
-        nodesWithComponent.push_back(node);
+    int location = (node->nodeName == "GND") ? -1 : findNodeLocationFromNode(node);
+    for (auto c : node->components) {
+      if (c.first->Type != Component::ComponentType::DIODE) {
+        continue;
+      }
+      auto diode = dynamic_cast<Diode *>(c.first.get());
+      // Each node has its own copy of the component, so they are matched by name
+      auto it = std::find_if(diodes.begin(), diodes.end(), [&](auto& d) { return d.first->ComponentName == diode->ComponentName; });
+      if (it == diodes.end()) {
+        diodes.push_back({diode, {-1, -1}});
+        it = diodes.end() - 1;
+      }
+      if (c.second == Component::DIODE_P) {
+        it->second.first = location;
+      } else if (c.second == Component::DIODE_N) {
+        it->second.second = location;
       }
     }
   }
-  return nodesWithComponent;
+  for (auto& d : diodes) {
+    devices.push_back(std::make_shared<diodeDevice>(d.second.first, d.second.second, d.first->saturationCurrent()));
+  }
 }
 
 template<typename T1, typename T2, typename T3>
 int Circuit<T1, T2, T3>::findNodeLocationFromNode(Node *node) {
-  for (int i = 0; i < syms.rows; i++) {
-    for (int j = 0; j < syms.cols; j++) {
-      if (syms.data[i][j].name == node->nodeName) {
-        return i;
-      }
-    }
+  int location = symbols.find(node);
+  if (location == -1) {
+    std::cerr << "ERROR: Location Not Found" << std::endl;
   }
-  std::cerr << "ERROR: Location Not Found" << std::endl;
-  return -1;
+  return location;
 }
 template<typename T1, typename T2, typename T3>
 int Circuit<T1, T2, T3>::findNodeLocationFromSymbol(std::string symName) {
-  for (int i = 0; i < syms.rows; i++) {
-    for (int j = 0; j < syms.cols; j++) {
-      if (syms.data[i][j].name == symName) {
-        return i;
-      }
-    }
+  int location = symbols.find(symName);
+  if (location == -1) {
+    std::cerr << "ERROR: Location Not Found" << std::endl;
   }
-  std::cerr << "ERROR: Location Not Found" << std::endl;
-  return -1;
+  return location;
 }
 
 template<typename T1, typename T2, typename T3>
 void Circuit<T1, T2, T3>::generateSymbols() {
-  bool hasGround = false;
-  syms.rows = 0;
-  syms.cols = 1;
+  symbols.clear();
   for (auto node : nodes) {
-    syms.data.push_back({node->nodeName});
-    syms.rows++;
+    symbols.addNode(node);
   }
 
   for (auto node : nodes) {
     for (auto c : node->components) {
       if (c.first->Type == Component::ComponentType::VOLTAGESOURCE || c.first->Type == Component::ComponentType::INDUCTOR) {
-        symbol componetCurrent = symbol("i_" + c.first->ComponentName);
-        
-        if (!isInSymbols(componetCurrent)) {
-          syms.data.push_back({componetCurrent});
-          syms.rows++;
-        }
+        symbols.add("i_" + c.first->ComponentName);
       } else if (c.first->Type == Component::ComponentType::OPAMP) {
-        symbol componetCurrentP = symbol("i_" + c.first->ComponentName + "P");
-        symbol componetCurrentN = symbol("i_" + c.first->ComponentName + "N");
-        
-        if (!isInSymbols(componetCurrentP)) {
-          syms.data.push_back({componetCurrentP});
-          syms.rows++;
-        }
-        if (!isInSymbols(componetCurrentN)) {
-          syms.data.push_back({componetCurrentN});
-          syms.rows++;
-        }
-
+        symbols.add("i_" + c.first->ComponentName + "P");
+        symbols.add("i_" + c.first->ComponentName + "N");
       }
     }
   }
+
+  syms.data.clear();
+  for (int i = 0; i < symbols.size(); i++) {
+    syms.data.push_back({symbol(symbols.name(i))});
+  }
   syms.rows = syms.data.size();
+  syms.cols = 1;
 }
 
 template<typename T1, typename T2, typename T3>
 bool Circuit<T1, T2, T3>::isInSymbols(symbol sym) {
-  auto symsTransposed = syms.transpose();
-  auto it = std::find(symsTransposed.data[0].begin(), symsTransposed.data[0].end(), sym);
-  if (it == symsTransposed.data[0].end()) {
-    return false;
-  }
-  return true;
+  return symbols.contains(sym.name);
 }
 
 template<typename T1, typename T2, typename T3>
 void Circuit<T1, T2, T3>::preAllocateMatrixData() {
   int matrixSize = syms.rows;
-  A.rows = matrixSize;
-  A.cols = matrixSize;
-  A.createData();
-  
-  E.rows = matrixSize;
-  E.cols = matrixSize;
-  E.createData();
+  if (matrixSize >= sparseThreshold) {
+    useSparse = true;
+  }
+  if (useSparse) {
+    sparseA.rows = matrixSize;
+    sparseA.cols = matrixSize;
+    sparseA.createData();
+
+    sparseE.rows = matrixSize;
+    sparseE.cols = matrixSize;
+    sparseE.createData();
+  } else {
+    A.rows = matrixSize;
+    A.cols = matrixSize;
+    A.createData();
+
+    E.rows = matrixSize;
+    E.cols = matrixSize;
+    E.createData();
+  }
   
   f.rows = matrixSize;
   f.cols = 1;
   f.createData();
   
+  acSources.rows = matrixSize;
+  acSources.cols = 1;
+  acSources.createData();
+
   initalValues.rows = matrixSize;
   initalValues.cols = 1;
   initalValues.createData();
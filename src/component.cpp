@@ -1,4 +1,5 @@
 #include "component.h"
+#include "BMaths/nonlinearDevice.h"
 
 Component::Component(const std::string &Name, ComponentType Type)
     : ComponentName(Name), Type(Type) {}
@@ -18,6 +19,13 @@ Opamp::Opamp(const std::string &Name)
 Diode::Diode(const std::string &Name, double Value)
     : Component(Name, ComponentType::DIODE), voltageDrop(Value) {}
 
+double Diode::saturationCurrent() const {
+  if (voltageDrop > 0.0) {
+    return diodeDevice::saturationCurrentFromDrop(voltageDrop);
+  }
+  return 1e-14;
+}
+
 VoltageSource::VoltageSource(const std::string& Name, functionType type, std::vector<double> Values)
   : Component(Name, ComponentType::VOLTAGESOURCE), fType(type), Values(Values) {}
 
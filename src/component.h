@@ -63,7 +63,9 @@ public:
 class Diode : public Component {
 public:
   Diode(const std::string& Name, double Value);
+  // Value is the voltage drop at 1mA, with no value a silicon diode (Is = 1e-14A) is used
   double voltageDrop = 0.0;
+  double saturationCurrent() const;
 };
 
 class VoltageSource : public Component {
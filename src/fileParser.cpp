@@ -1,6 +1,8 @@
 #include "fileParser.h"
 #include "component.h"
 #include <memory>
+#include <algorithm>
+#include <cctype>
 
 token::token(tokenType type)
   :type(type) {};
@@ -8,6 +10,21 @@ token::token(tokenType type)
 timeToken::timeToken()
   : token(token::TIME) {};
   
+adaptiveToken::adaptiveToken()
+  : token(token::ADAPTIVE) {};
+
+operatingPointToken::operatingPointToken()
+  : token(token::OPERATING_POINT) {};
+
+acToken::acToken()
+  : token(token::AC_SWEEP) {};
+
+sweepToken::sweepToken()
+  : token(token::SWEEP) {};
+
+monteCarloToken::monteCarloToken()
+  : token(token::MONTE_CARLO) {};
+
 componentToken::componentToken(Component::ComponentType componentType)
   : token(token::COMPONENT), componentType(componentType) {};
 
@@ -33,8 +50,7 @@ fileParser::fileParser(const std::string& filename) {
   std::string line;
   if (file.is_open()) {
     while (std::getline(file, line)) {
-      auto lineTokens = tokenize(removeComments(line));
-      tokens = lineTokens;
+      tokenize(removeComments(line));
     }
     file.close();
   } else {
@@ -53,27 +69,70 @@ std::string fileParser::removeComments(std::string line) {
   return line;
 }
 
-std::vector<std::shared_ptr<token>> fileParser::tokenize(const std::string& line) {
-  std::istringstream stream(line);
-  std::string currentToken;
-  for (char c : line) {
-    currentToken = currentToken + c;
-    if (tokenIsTime(currentToken)) {
-      addTime(line);
-    } else if (tokenIsComponent(currentToken)) {
-      addComponent(line);
-    } else if (tokenIsNode(currentToken)) {
-      addNode(line);
-    } else if (tokenIsPlot(currentToken)) {
-      addPlot(line);
-    } else if (tokenIsFourier(currentToken)) {
-      addFourier(line);
-    } else if (tokenIsCalculate(currentToken)) {
-      addCalculate(line);
-    }
+// The keyword is everything before the first {, it picks what the line is
+void fileParser::tokenize(const std::string& line) {
+  using addFunction = void (fileParser::*)(const std::string&);
+  static const std::unordered_map<std::string, addFunction> keywords = {
+    {"time", &fileParser::addTime},
+    {"adaptive", &fileParser::addAdaptive},
+    {"operating_point", &fileParser::addOperatingPoint},
+    {"ac", &fileParser::addAC},
+    {"sweep", &fileParser::addSweep},
+    {"monte_carlo", &fileParser::addMonteCarlo},
+    {"resistor", &fileParser::addComponent},
+    {"capacitor", &fileParser::addComponent},
+    {"voltage_source", &fileParser::addComponent},
+    {"inductor", &fileParser::addComponent},
+    {"opamp", &fileParser::addComponent},
+    {"diode", &fileParser::addComponent},
+    {"node", &fileParser::addNode},
+    {"plot", &fileParser::addPlot},
+    {"fourier_transform", &fileParser::addFourier},
+    {"calculate", &fileParser::addCalculate},
+  };
+  int end = 0;
+  while (end < line.size() && (std::isalnum(line[end]) || line[end] == '_')) {
+    end++;
+  }
+  auto it = keywords.find(line.substr(0, end));
+  if (it != keywords.end()) {
+    (this->*(it->second))(line);
   }
+}
 
-  return tokens;
+void fileParser::addToken(std::shared_ptr<token> t) {
+  std::string name;
+  switch (t->type) {
+  case token::TIME: name = dynamic_cast<timeToken *>(t.get())->name; break;
+  case token::ADAPTIVE: name = dynamic_cast<adaptiveToken *>(t.get())->name; break;
+  case token::OPERATING_POINT: name = dynamic_cast<operatingPointToken *>(t.get())->name; break;
+  case token::AC_SWEEP: name = dynamic_cast<acToken *>(t.get())->name; break;
+  case token::SWEEP: name = dynamic_cast<sweepToken *>(t.get())->name; break;
+  case token::MONTE_CARLO: name = dynamic_cast<monteCarloToken *>(t.get())->name; break;
+  case token::COMPONENT: {
+    name = dynamic_cast<componentToken *>(t.get())->name;
+    componentLocations[name].push_back(tokens.size());
+    break;
+  }
+  case token::NODE: name = dynamic_cast<nodeToken *>(t.get())->name; break;
+  case token::FOURIER: name = dynamic_cast<fourierToken *>(t.get())->name; break;
+  case token::CALCULATE: name = dynamic_cast<calculateToken *>(t.get())->name; break;
+  case token::DATA: {
+    name = dynamic_cast<dataToken *>(t.get())->name;
+    dataTokens.emplace(name, std::dynamic_pointer_cast<dataToken>(t));
+    break;
+  }
+  case token::PLOT: {
+    tokens.push_back(t);
+    return;
+  }
+  default: {
+    std::cerr << "ERROR: Token of type " << t->type << " was not handled" << std::endl;
+    break;
+  }
+  }
+  namedTokens.emplace(name, t);
+  tokens.push_back(t);
 }
 
 
@@ -181,73 +240,13 @@ calculateToken::calculateType fileParser::getCalculateType(std::string input) {
   return calculateToken::VOLTAGE;
 }
 
+// Every data token goes through getData, so they are all in dataTokens
 bool fileParser::isDataDefined(std::string varName) {
-  for(auto& token : tokens) {
-    switch (token->type) {
-    case token::PLOT: {
-      break;
-    }
-    case token::TIME: {
-      auto t = dynamic_cast<timeToken *>(token.get());
-      auto stopTime = dynamic_cast<dataToken *>(t->stopTime.get());
-      auto timeStep = dynamic_cast<dataToken *>(t->timeStep.get());
-      if (stopTime->name == varName) { return true; }
-      if (timeStep->name == varName) { return true; }
-      break;
-    }
-    case token::COMPONENT: {
-      auto t = dynamic_cast<componentToken *>(token.get());
-      auto voltageData = dynamic_cast<dataToken *>(t->voltageDataToken.get());
-      auto currentData = dynamic_cast<dataToken *>(t->currentDataToken.get());
-      if (voltageData->name == varName) { return true; }
-      if (currentData->name == varName) { return true; }
-      break;
-    }
-    case token::NODE: {
-      auto t = dynamic_cast<nodeToken *>(token.get());
-      auto voltageData = dynamic_cast<dataToken *>(t->voltageDataToken.get());
-      if (voltageData->name == varName) { return true; }
-      break;
-    }
-    case token::FOURIER: {
-      auto t = dynamic_cast<fourierToken *>(token.get());
-      auto inputData = dynamic_cast<dataToken *>(t->inputDataToken.get());
-      auto outputData = dynamic_cast<dataToken *>(t->outputDataToken.get());
-      if (inputData->name == varName) { return true; }
-      if (outputData->name == varName) { return true; }
-      break;
-    }
-    case token::CALCULATE: {
-      auto t = dynamic_cast<calculateToken *>(token.get());
-      for (auto& d : t->inputs) {
-        auto data = dynamic_cast<dataToken *>(d.get());
-        if (data->name == varName) { return true; }
-      }
-      break;
-    }
-    case token::DATA: {
-      auto t = dynamic_cast<dataToken *>(token.get());
-      if (t->name == varName) { return true; }
-      break;
-    }
-    default: {
-
-      std::cerr << "ERROR: Varible type not detected." << std::endl;
-      break;
-    }
-    }
-  }
-  return false;
+  return dataTokens.count(varName) != 0;
 }
 
 bool fileParser::isComponentDefined(std::string cName) {
-  for(auto& token : tokens) {
-    if (token->type == token::COMPONENT) {
-      auto t = dynamic_cast<componentToken *>(token.get());
-      if (t->name == cName) { return true; }
-    }
-  }
-  return false;
+  return componentLocations.count(cName) != 0;
 }
   
 
@@ -309,59 +308,27 @@ void fileParser::verifyCalculateArguments(calculateToken::calculateType type, st
 
 
 std::shared_ptr<token> fileParser::getTokenPtrFromName(const std::string& argName) {
-  for(auto& token : tokens) {
-    switch (token->type) {
-    case token::PLOT: {
-      break;
-    }
-    case token::TIME: {
-      auto t = dynamic_cast<timeToken *>(token.get());
-      if (t->name == argName) { return token; }
-      break;
-    }
-    case token::COMPONENT: {
-      auto t = dynamic_cast<componentToken *>(token.get());
-      if (t->name == argName) { return token; }
-      break;
-    }
-    case token::NODE: {
-      auto t = dynamic_cast<nodeToken *>(token.get());
-      if (t->name == argName) { return token; }
-      break;
-    }
-    case token::FOURIER: {
-      auto t = dynamic_cast<fourierToken *>(token.get());
-      if (t->name == argName) { return token; }
-      break;
-    }
-    case token::CALCULATE: {
-      auto t = dynamic_cast<calculateToken *>(token.get());
-      if (t->name == argName) { return token; }
-      break;
-    }
-    case token::DATA: {
-      auto t = dynamic_cast<dataToken *>(token.get());
-      if (t->name == argName) { return token; }
-      break;
-    }
-    default: {
-      std::cerr << "ERROR: Varible type not detected." << std::endl;
-      break;
-    }
-    }
-
+  auto it = namedTokens.find(argName);
+  if (it == namedTokens.end()) {
+    return nullptr;
   }
-  //std::cerr << "ERROR: Unable to find token, this should be unreachable" << std::endl;
-  //std::cerr << "Token name is:" << argName << std::endl;
-  return nullptr;
+  return it->second;
 }
 
 void fileParser::addTime(const std::string &line) {
   auto time = std::make_shared<timeToken>();
   std::vector<std::string> inputs = getInputs(line);
-  if (inputs.size() != 2) {
-    std::cerr << "ERROR: time must have two number inputs." << std::endl;
-    std::cerr << "EX: time{STOP_TIME}{TIME_STEP}" << std::endl;
+  if (inputs.size() != 2 && inputs.size() != 3) {
+    std::cerr << "ERROR: time must have two number inputs and an optional integration method." << std::endl;
+    std::cerr << "EX: time{STOP_TIME}{TIME_STEP} or time{STOP_TIME}{TIME_STEP}{BE}" << std::endl;
+  }
+  if (inputs.size() == 3) {
+    integrationMethod method;
+    if (getIntegrationMethod(inputs[2], method)) {
+      time->method = inputs[2];
+    } else {
+      std::cerr << "ERROR: Unknown integration method " << inputs[2] << ", use FE, BE, TRAP or BDF2." << std::endl;
+    }
   }
   time->stopTime = getData("STOP_TIME");
   time->timeStep = getData("TIME_STEP");
@@ -369,7 +336,92 @@ void fileParser::addTime(const std::string &line) {
   stopTime->addData({getValue(inputs[0])});
   auto timeStep = dynamic_cast<dataToken *>(time->timeStep.get());
   timeStep->addData({getValue(inputs[1])});
-  tokens.push_back(time);
+  addToken(time);
+}
+
+void fileParser::addAdaptive(const std::string &line) {
+  auto adaptive = std::make_shared<adaptiveToken>();
+  std::vector<std::string> inputs = getInputs(line);
+  if (inputs.size() != 2) {
+    std::cerr << "ERROR: adaptive must have two number inputs." << std::endl;
+    std::cerr << "EX: adaptive{TOLERANCE}{MAX_STEP}" << std::endl;
+    return;
+  }
+  adaptive->tolerance = getValue(inputs[0]);
+  adaptive->maxStep = getValue(inputs[1]);
+  if (adaptive->tolerance <= 0.0 || adaptive->maxStep <= 0.0) {
+    std::cerr << "ERROR: adaptive tolerance and max step must be positive." << std::endl;
+  }
+  addToken(adaptive);
+}
+
+void fileParser::addOperatingPoint(const std::string &line) {
+  auto operatingPoint = std::make_shared<operatingPointToken>();
+  std::vector<std::string> inputs = getInputs(line);
+  if (inputs.size() != 1 || (inputs[0] != "PRINT" && inputs[0] != "SEED")) {
+    std::cerr << "ERROR: operating_point must have one input, PRINT or SEED." << std::endl;
+    std::cerr << "EX: operating_point{SEED}" << std::endl;
+    return;
+  }
+  operatingPoint->seedTransient = inputs[0] == "SEED";
+  addToken(operatingPoint);
+}
+
+void fileParser::addAC(const std::string &line) {
+  auto ac = std::make_shared<acToken>();
+  std::vector<std::string> inputs = getInputs(line);
+  if (inputs.size() != 3) {
+    std::cerr << "ERROR: ac must have three number inputs." << std::endl;
+    std::cerr << "EX: ac{START_FREQUENCY}{STOP_FREQUENCY}{POINTS}" << std::endl;
+    return;
+  }
+  ac->start = getValue(inputs[0]);
+  ac->stop = getValue(inputs[1]);
+  ac->points = (int)getValue(inputs[2]);
+  if (ac->start <= 0.0 || ac->stop < ac->start || ac->points < 1) {
+    std::cerr << "ERROR: ac needs 0 < START_FREQUENCY <= STOP_FREQUENCY and at least one point." << std::endl;
+    return;
+  }
+  addToken(ac);
+}
+
+void fileParser::addSweep(const std::string &line) {
+  auto sweep = std::make_shared<sweepToken>();
+  std::vector<std::string> inputs = getInputs(line);
+  if (inputs.size() != 4) {
+    std::cerr << "ERROR: sweep must have a component and three number inputs." << std::endl;
+    std::cerr << "EX: sweep{COMPONENT}{START}{STOP}{POINTS}" << std::endl;
+    return;
+  }
+  sweep->componentName = getName(inputs[0]);
+  sweep->start = getValue(inputs[1]);
+  sweep->stop = getValue(inputs[2]);
+  sweep->points = (int)getValue(inputs[3]);
+  if (sweep->points < 1 || sweep->start <= 0.0 || sweep->stop <= 0.0) {
+    std::cerr << "ERROR: sweep needs positive values and at least one point." << std::endl;
+    return;
+  }
+  addToken(sweep);
+}
+
+void fileParser::addMonteCarlo(const std::string &line) {
+  auto monteCarlo = std::make_shared<monteCarloToken>();
+  std::vector<std::string> inputs = getInputs(line);
+  if (inputs.size() != 2 && inputs.size() != 3) {
+    std::cerr << "ERROR: monte_carlo must have two or three inputs." << std::endl;
+    std::cerr << "EX: monte_carlo{RUNS}{TOLERANCE}{OPTIONAL SEED}" << std::endl;
+    return;
+  }
+  monteCarlo->runs = (int)getValue(inputs[0]);
+  monteCarlo->tolerance = getValue(inputs[1]);
+  if (inputs.size() == 3) {
+    monteCarlo->seed = (unsigned int)getValue(inputs[2]);
+  }
+  if (monteCarlo->runs < 1 || monteCarlo->tolerance < 0.0 || monteCarlo->tolerance >= 1.0) {
+    std::cerr << "ERROR: monte_carlo needs at least one run and 0 <= TOLERANCE < 1." << std::endl;
+    return;
+  }
+  addToken(monteCarlo);
 }
 
 bool fileParser::sourceIsFunction(std::vector<std::string> inputs) {
@@ -429,6 +481,12 @@ void fileParser::checkIfComponentIsValid(std::shared_ptr<componentToken> compone
 }
 
 void fileParser::createVoltageSource(std::shared_ptr<componentToken> component, std::vector<std::string> inputs) {
+  // Already reported by checkIfComponentIsValid, it is kept without values so the circuit leaves it at 0V
+  if (sourceIsFunction(inputs) && inputs.size() < 5) {
+    component->fType = (inputs[1] == "AC") ? VoltageSource::AC : VoltageSource::SQUARE_WAVE;
+    component->name = getName(inputs[0]);
+    return;
+  }
   if (inputs[1] == "AC") {
     std::string name = getName(inputs[0]);
     double amplitude = getValue(inputs[2]);
@@ -489,15 +547,12 @@ void fileParser::addComponent(const std::string &line) {
   
   component->voltageDataToken = getData("v_" + component->name);
   component->currentDataToken = getData("i_" + component->name);
-  tokens.push_back(component);
+  addToken(component);
 }
 
 void fileParser::addNode(const std::string &line) {
   auto node = std::make_shared<nodeToken>();
   std::vector<std::string> inputs = getInputs(line);
-  for (auto& s : inputs) {
-    std::vector<std::string> subInputs = getInputs(line);
-  }
   if (inputs.size() < 2) {
     std::cerr << "ERROR: Nodes must have N + 1 inputs." << std::endl;
     std::cerr << "EX: node{NAME}{COMPONENT_1}{COMPONENT_2}...{COMPONENT_N}" << std::endl;
@@ -510,85 +565,95 @@ void fileParser::addNode(const std::string &line) {
     componentNames[i] = getName(componentNames[i]);
   }
 
+  // The components are kept in the order they were defined in
+  std::vector<int> locations;
   for (auto& name : componentNames) {
-    if (!isComponentDefined(name)) {
+    auto it = componentLocations.find(name);
+    if (it == componentLocations.end()) {
       std::cerr << "ERROR: Component `" << name << "` not defined." << std::endl;
+      continue;
     }
+    locations.insert(locations.end(), it->second.begin(), it->second.end());
   }
+  std::sort(locations.begin(), locations.end());
+  locations.erase(std::unique(locations.begin(), locations.end()), locations.end());
 
   std::vector<std::pair<std::shared_ptr<token>, Component::connectionType>> componentTokens;
   
-  for (auto& token : tokens) {
-    if (token->type == token::COMPONENT) {
-      auto component = dynamic_cast<componentToken *>(token.get());
-      auto itComponent = std::find(componentNames.begin(), componentNames.end(), component->name);
-      //auto itDuplicate = std::find(componentTokens.begin(), componentTokens.end(), token);
-      if(itComponent != componentNames.end()) {// && itDuplicate == componentTokens.end()) {
-        if (component->componentType == Component::DIODE) {
-          for (auto& input : getInputs(line)) {
-            if (getName(input) == component->name) {
-              std::vector<std::string> diodeInputs = getInputs(input);
-              if (diodeInputs.size() != 1) {
-                std::cerr << "ERROR: When applying a diode to a node you must define the connection direction" << std::endl;
-                std::cerr << "DIODE_NAME{+ OR -}" << std::endl;
-              }
-              if (diodeInputs[0] == "+") {
-                componentTokens.push_back(std::make_pair(token, Component::DIODE_P));
-              } else if (diodeInputs[0] == "-") {
-                componentTokens.push_back(std::make_pair(token, Component::DIODE_N));
-              } else {
-                std::cerr << "ERROR: When applying a diode to a node you must define the connection direction" << std::endl;
-                std::cerr << "DIODE_NAME{+ OR -}" << std::endl;
-              }
-            }
+  for (int location : locations) {
+    auto& token = tokens[location];
+    auto component = dynamic_cast<componentToken *>(token.get());
+    if (component->componentType == Component::DIODE) {
+      for (auto& input : inputs) {
+        if (getName(input) == component->name) {
+          std::vector<std::string> diodeInputs = getInputs(input);
+          if (diodeInputs.size() != 1) {
+            std::cerr << "ERROR: When applying a diode to a node you must define the connection direction" << std::endl;
+            std::cerr << "DIODE_NAME{+ OR -}" << std::endl;
           }
-        } if (component->componentType == Component::OPAMP) {
-          for (auto& input : getInputs(line)) {
-            if (getName(input) == component->name) {
-              std::vector<std::string> opampInputs = getInputs(input);
-              if (opampInputs.size() != 1) {
-                std::cerr << "ERROR: When applying a opamp to a node you must define the connection direction" << std::endl;
-                std::cerr << "OPAMP_NAME{+ OR - OR out}" << std::endl;
-              }
-              if (opampInputs[0] == "+") {
-                componentTokens.push_back(std::make_pair(token, Component::OPAMP_P));
-              } else if (opampInputs[0] == "-") {
-                componentTokens.push_back(std::make_pair(token, Component::OPAMP_N));
-              } else if (opampInputs[0] == "out") {
-                componentTokens.push_back(std::make_pair(token, Component::OPAMP_OUT));
-              } else {
-                std::cerr << "ERROR: When applying a opamp to a node you must define the connection direction" << std::endl;
-                std::cerr << "OPAMP_NAME{+ OR - OR out}" << std::endl;
-              }
-            }
+          if (diodeInputs[0] == "+") {
+            componentTokens.push_back(std::make_pair(token, Component::DIODE_P));
+          } else if (diodeInputs[0] == "-") {
+            componentTokens.push_back(std::make_pair(token, Component::DIODE_N));
+          } else {
+            std::cerr << "ERROR: When applying a diode to a node you must define the connection direction" << std::endl;
+            std::cerr << "DIODE_NAME{+ OR -}" << std::endl;
           }
-        } else {
-          componentTokens.push_back(std::make_pair(token, Component::UNDEFINED));
         }
       }
+    } else if (component->componentType == Component::OPAMP) {
+      for (auto& input : inputs) {
+        if (getName(input) == component->name) {
+          std::vector<std::string> opampInputs = getInputs(input);
+          if (opampInputs.size() != 1) {
+            std::cerr << "ERROR: When applying a opamp to a node you must define the connection direction" << std::endl;
+            std::cerr << "OPAMP_NAME{+ OR - OR out}" << std::endl;
+          }
+          if (opampInputs[0] == "+") {
+            componentTokens.push_back(std::make_pair(token, Component::OPAMP_P));
+          } else if (opampInputs[0] == "-") {
+            componentTokens.push_back(std::make_pair(token, Component::OPAMP_N));
+          } else if (opampInputs[0] == "out") {
+            componentTokens.push_back(std::make_pair(token, Component::OPAMP_OUT));
+          } else {
+            std::cerr << "ERROR: When applying a opamp to a node you must define the connection direction" << std::endl;
+            std::cerr << "OPAMP_NAME{+ OR - OR out}" << std::endl;
+          }
+        }
+      }
+    } else {
+      componentTokens.push_back(std::make_pair(token, Component::UNDEFINED));
     }
   }
     
   node->components = componentTokens;
   node->voltageDataToken = getData(node->name);
-  tokens.push_back(node);
+  addToken(node);
 }
 
 void fileParser::addPlot(const std::string &line) {
   auto plot = std::make_shared<plotToken>();
   std::vector<std::string> inputs = getInputs(line);
-  if (inputs.size() != 1) {
-    std::cerr << "ERROR: Plots must have 1 input." << std::endl;
-    std::cerr << "EX: plot{VARIBLE_NAME}" << std::endl;
+  if (inputs.size() != 1 && inputs.size() != 2) {
+    std::cerr << "ERROR: Plots must have 1 or 2 inputs." << std::endl;
+    std::cerr << "EX: plot{VARIBLE_NAME} or plot{VARIBLE_NAME}{EVERY_NTH_POINT}" << std::endl;
+    return;
   }
   
   std::string varibleName = getName(inputs[0]);
   plot->plotVaribleName = varibleName;
+  if (inputs.size() == 2) {
+    plot->decimation = (int)getValue(inputs[1]);
+    if (plot->decimation < 1) {
+      std::cerr << "ERROR: Plot of " << varibleName << " must keep every 1 or more points." << std::endl;
+      plot->decimation = 1;
+    }
+  }
   if (!isDataDefined(plot->plotVaribleName)) {
     std::cerr << "ERROR: Unable to create plot, the varible " << plot->plotVaribleName << " is not defined." << std::endl;
   }
   plot->dataToken = getData(plot->plotVaribleName);
-  tokens.push_back(plot);
+  addToken(plot);
 }
 
 
@@ -609,7 +674,7 @@ void fileParser::addCalculate(const std::string &line) {
     std::cerr << "ERROR: Could not calculate, the varible " << calculate->name  << " is already defined." << std::endl;
   }
   calculate->output = getData(calculate->name);
-  tokens.push_back(calculate);
+  addToken(calculate);
 }
 
 
@@ -629,90 +694,19 @@ void fileParser::addFourier(const std::string &line) {
   fourier->name = inputVaribleName;
   fourier->outputDataToken = getData(inputVaribleName);
   fourier->inputDataToken = getData(varibleToTransformName);
-  tokens.push_back(fourier);
+  addToken(fourier);
 }
 
 
 
 
 std::shared_ptr<dataToken> fileParser::getData(std::string name) {
-  for (auto& token : tokens) {
-    switch (token->type) {
-    case token::TIME: {
-      auto t = dynamic_cast<timeToken *>(token.get());
-      std::shared_ptr<dataToken> stopTime = std::dynamic_pointer_cast<dataToken>(t->stopTime);
-      if (stopTime->name == name) {
-        return stopTime;
-      }
-      std::shared_ptr<dataToken> timeStep = std::dynamic_pointer_cast<dataToken>(t->timeStep);
-      if (stopTime->name == name) {
-        return timeStep;
-      }
-      break;
-    }
-    case token::COMPONENT: {
-      auto t = dynamic_cast<componentToken *>(token.get());
-      std::shared_ptr<dataToken> vDataT = std::dynamic_pointer_cast<dataToken>(t->voltageDataToken);
-      if (vDataT->name == name) {
-        return vDataT;
-      }
-      std::shared_ptr<dataToken> cDataT = std::dynamic_pointer_cast<dataToken>(t->currentDataToken);
-      if (cDataT->name == name) {
-        return cDataT;
-      }
-      break;
-    }
-    case token::NODE: {
-      auto t = dynamic_cast<nodeToken *>(token.get());
-      std::shared_ptr<dataToken> dataT = std::dynamic_pointer_cast<dataToken>(t->voltageDataToken);
-      if (dataT->name == name) {
-        return dataT;
-      }
-      break;
-    }
-    case token::PLOT: {
-      auto t = dynamic_cast<plotToken *>(token.get());
-      std::shared_ptr<dataToken> dataT = std::dynamic_pointer_cast<dataToken>(t->dataToken);
-      if (dataT->name == name) {
-        return dataT;
-      }
-      break;
-    }
-    case token::FOURIER: {
-      auto t = dynamic_cast<fourierToken *>(token.get());
-      std::shared_ptr<dataToken> inDataT = std::dynamic_pointer_cast<dataToken>(t->inputDataToken);
-      if (inDataT->name == name) {
-        return inDataT;
-      }
-      std::shared_ptr<dataToken> outDataT = std::dynamic_pointer_cast<dataToken>(t->outputDataToken);
-      if (outDataT->name == name) {
-        return outDataT;
-      }
-      break;
-    }
-    case token::CALCULATE: {
-      auto t = dynamic_cast<calculateToken *>(token.get());
-      std::shared_ptr<dataToken> dataT = std::dynamic_pointer_cast<dataToken>(t->output);
-      if (dataT->name == name) {
-        return dataT;
-      }
-      break;
-    }
-    case token::DATA: {
-      std::shared_ptr<dataToken> dataT = std::dynamic_pointer_cast<dataToken>(token);
-      if (dataT->name == name) {
-        return dataT;
-      }
-      break;
-    }
-    default:
-      
-      std::cerr << "ERROR: Token of type " << token->type << " was not handled" << std::endl;
-      break;
-    }
+  auto it = dataTokens.find(name);
+  if (it != dataTokens.end()) {
+    return it->second;
   }
   auto output = std::make_shared<dataToken>(name);
-  tokens.push_back(output);
+  addToken(output);
   return output;
 }
 
@@ -750,31 +744,3 @@ std::shared_ptr<componentToken> fileParser::getComponent(const std::string &line
   std::cerr << "ERROR: Component not found" << std::endl;
   return 0;
 }
-
-bool fileParser::tokenIsTime(std::string token) {
-    return token == "time";
-}
-
-bool fileParser::tokenIsComponent(std::string token) {
-  return token == "resistor" || token == "capacitor" || token == "voltage_source" || token == "inductor" || token == "opamp" || token == "diode";
-}
-
-bool fileParser::tokenIsNode(std::string token) {
-  return token == "node";
-}
-
-bool fileParser::tokenIsPlot(std::string token) {
-  return token == "plot";
-}
-bool fileParser::tokenIsFourier(std::string token) {
-  return token == "fourier_transform";
-}
-
-bool fileParser::tokenIsCalculate(std::string token) {
-    return token == "calculate";
-}
-
-
-
-
-
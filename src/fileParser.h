@@ -3,6 +3,7 @@
 #include <fstream>
 #include <memory>
 #include <utility>
+#include <unordered_map>
 #include "circuit.h"
 
 
@@ -10,6 +11,11 @@ class token {
 public:
   enum tokenType {
     TIME, 
+    ADAPTIVE,
+    OPERATING_POINT,
+    AC_SWEEP,
+    SWEEP,
+    MONTE_CARLO,
     COMPONENT,
     NODE,
     PLOT,
@@ -30,6 +36,54 @@ public:
   
   std::string name = "time token";
   std::shared_ptr<token> stopTime, timeStep;
+  std::string method = "FE"; // FE, BE, TRAP or BDF2
+
+};
+
+class adaptiveToken : public token {
+public:
+  adaptiveToken();
+
+  std::string name = "adaptive token";
+  double tolerance = 1e-3;
+  double maxStep = 0.0;
+};
+
+class operatingPointToken : public token {
+public:
+  operatingPointToken();
+
+  std::string name = "operating point token";
+  bool seedTransient = false; // PRINT or SEED
+};
+
+class acToken : public token {
+public:
+  acToken();
+
+  std::string name = "ac token";
+  double start = 0.0, stop = 0.0;
+  int points = 0;
+};
+
+class sweepToken : public token {
+public:
+  sweepToken();
+
+  std::string name = "sweep token";
+  std::string componentName;
+  double start = 0.0, stop = 0.0;
+  int points = 0;
+};
+
+class monteCarloToken : public token {
+public:
+  monteCarloToken();
+
+  std::string name = "monte carlo token";
+  int runs = 0;
+  double tolerance = 0.0;
+  unsigned int seed = 1;
 };
 
 class componentToken : public token {
@@ -66,6 +120,7 @@ public:
   
   std::string plotVaribleName;
   std::shared_ptr<token> dataToken;
+  int decimation = 1; // Only every decimation-th point is plotted
 
 };
 
@@ -83,6 +138,7 @@ public:
   
   std::string name;
   std::vector<std::vector<double>> data;
+  int decimation = 1; // data has every decimation-th point of time
   
   inline void addData(std::vector<double> dataIn) { data.push_back(dataIn); };
 };
@@ -115,7 +171,15 @@ public:
   fileParser(const std::string& filename);
   std::vector<std::shared_ptr<token>> tokens;
 private:
-  std::vector<std::shared_ptr<token>> tokenize(const std::string& line);
+  void tokenize(const std::string& line);
+  // Adds t to tokens and to the lookups below
+  void addToken(std::shared_ptr<token> t);
+
+  // The first token with each name, the data tokens by name and where each component is in tokens.
+  // These are kept up to date by addToken so nothing has to search through tokens
+  std::unordered_map<std::string, std::shared_ptr<token>> namedTokens;
+  std::unordered_map<std::string, std::shared_ptr<dataToken>> dataTokens;
+  std::unordered_map<std::string, std::vector<int>> componentLocations;
   
   std::string removeComments(std::string line);
     
@@ -137,6 +201,11 @@ private:
   void createDiode(std::shared_ptr<componentToken> component, std::vector<std::string> inputs);
 
   void addTime(const std::string &line);
+  void addAdaptive(const std::string &line);
+  void addOperatingPoint(const std::string &line);
+  void addAC(const std::string &line);
+  void addSweep(const std::string &line);
+  void addMonteCarlo(const std::string &line);
   void addComponent(const std::string &line);
   void addNode(const std::string &line);
   void addPlot(const std::string &line);
@@ -145,11 +214,4 @@ private:
 
   std::shared_ptr<componentToken> getComponent(const std::string &line);
   std::shared_ptr<dataToken> getData(std::string name);
-  
-  bool tokenIsTime(std::string token);
-  bool tokenIsComponent(std::string token);
-  bool tokenIsNode(std::string token);
-  bool tokenIsPlot(std::string token);
-  bool tokenIsFourier(std::string token);
-  bool tokenIsCalculate(std::string token);
 };
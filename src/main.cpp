@@ -1,6 +1,9 @@
 #include "circuit.h"
 #include "fileParser.h"
 #include "tokenParser.h"
+#include "sweep.h"
+#include <chrono>
+#include <memory>
 #include <cstdio>
 #include <string>
 #include <vector>
@@ -8,12 +11,60 @@
 
 int main(int argc, char* argv[]) {
   if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " <input_file>" << std::endl;
+    std::cerr << "Usage: " << argv[0] << " <input_file> [--sparse] [--method FE|BE|TRAP|BDF2] [--op] [--output FILE] [--raw] [--threads N] [--ordering NATURAL|RCM|MD]" << std::endl;
   }
   std::string inputFile = argv[1];
+  bool forceSparse = false;
+  std::string methodName = "";
+  bool seedFromOperatingPoint = false;
+  // With --output the points are streamed to a SPICE raw file instead of kept, plotData.m is then not written
+  std::string outputFile = "";
+  // With --raw the plotted vectors are written to plotData.raw, plotData.m only loads and plots them
+  bool writeRaw = false;
+  // Threads for the sweep runs and the dense kernels, 0 is every core for sweeps and one thread for the dense kernels
+  int threads = 0;
+  for (int i = 2; i < argc; i++) {
+    if (std::string(argv[i]) == "--sparse") {
+      forceSparse = true;
+    } else if (std::string(argv[i]) == "--op") {
+      seedFromOperatingPoint = true;
+    } else if (std::string(argv[i]) == "--method" && i + 1 < argc) {
+      methodName = argv[++i];
+    } else if (std::string(argv[i]) == "--output" && i + 1 < argc) {
+      outputFile = argv[++i];
+    } else if (std::string(argv[i]) == "--raw") {
+      writeRaw = true;
+    } else if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+      threads = std::stoi(argv[++i]);
+      setDenseThreads(threads);
+    } else if (std::string(argv[i]) == "--ordering" && i + 1 < argc) {
+      // How the sparse solver reorders the unknowns, the output keeps the netlist order
+      std::string orderingName = argv[++i];
+      if (orderingName == "NATURAL") {
+        sparseLU::defaultOrdering = sparseLU::NATURAL;
+      } else if (orderingName == "RCM") {
+        sparseLU::defaultOrdering = sparseLU::REVERSE_CUTHILL_MCKEE;
+      } else if (orderingName == "MD") {
+        sparseLU::defaultOrdering = sparseLU::MINIMUM_DEGREE;
+      } else {
+        std::cerr << "ERROR: Unknown ordering `" << orderingName << "`, use NATURAL, RCM or MD" << std::endl;
+      }
+    } else {
+      std::cerr << "ERROR: Unknown argument `" << argv[i] << "`" << std::endl;
+    }
+  }
   fileParser parsedFile(inputFile);
   auto tokens = parsedFile.tokens;
   Circuit<double, double, function> circuit = createCircuitFromTokens<double, double, function>(tokens);
+  circuit.useSparse = forceSparse;
+  // The command line overrides the method from the time line
+  if (methodName != "" && !getIntegrationMethod(methodName, circuit.method)) {
+    std::cerr << "ERROR: Unknown integration method `" << methodName << "`, use FE, BE, TRAP or BDF2" << std::endl;
+  }
+  if (seedFromOperatingPoint) {
+    circuit.findOperatingPoint = true;
+    circuit.seedFromOperatingPoint = true;
+  }
   circuit.calculate();
   auto& initalValues = circuit.initalValues;
   auto& A = circuit.A;
@@ -22,9 +73,101 @@ int main(int argc, char* argv[]) {
   auto& s = circuit.syms;
   double& stopTime = circuit.stopTime;
   double& timeStep = circuit.timeStep;
-  DifferentialAlgebraicEquation<double, double, function> DAE = {A, E, f, s};
-  auto output = DAESolve2(DAE, initalValues, timeStep, stopTime);
-  postProcess("plotData.m", output.first, output.second, s, tokens);
+
+  matrix<double> operatingPoint;
+  bool foundOperatingPoint = false;
+  // The AC sweep needs the operating point to linearise the diodes around
+  bool needOperatingPoint = circuit.runACSweep && !circuit.devices.empty();
+  if (circuit.findOperatingPoint || needOperatingPoint) {
+    if (circuit.useSparse) {
+      foundOperatingPoint = DCOperatingPoint(circuit.sparseA, f, circuit.nodes.size(), 0.0, operatingPoint, circuit.devices);
+    } else {
+      foundOperatingPoint = DCOperatingPoint(A, f, circuit.nodes.size(), 0.0, operatingPoint, circuit.devices);
+    }
+  }
+  if (circuit.findOperatingPoint && foundOperatingPoint) {
+    std::cout << "DC operating point:" << std::endl;
+    for (int row = 0; row < s.rows; row++) {
+      std::cout << s[row][0].name << " = " << std::scientific << std::setprecision(5) << operatingPoint[row][0] << std::endl;
+    }
+    if (circuit.seedFromOperatingPoint) {
+      initalValues = operatingPoint;
+    }
+  }
+
+  if (circuit.runACSweep) {
+    auto frequencies = createLogFrequencies(circuit.acStart, circuit.acStop, circuit.acPoints);
+    if (needOperatingPoint && !foundOperatingPoint) {
+      std::cerr << "ERROR: The AC sweep needs a DC operating point to linearise the diodes, none was found" << std::endl;
+    } else {
+      ACResult acResult;
+      if (circuit.useSparse) {
+        acResult = ACSweep(linearizeDevices(circuit.sparseA, circuit.devices, operatingPoint.data), circuit.sparseE, circuit.acSources, frequencies);
+      } else {
+        acResult = ACSweep(linearizeDevices(A, circuit.devices, operatingPoint.data), E, circuit.acSources, frequencies);
+      }
+      writeACData("acData.m", acResult, s, tokens);
+    }
+  }
+
+  // Without a time line there is only the DC or AC analysis
+  if (stopTime <= 0.0 || timeStep <= 0.0) {
+    return 0;
+  }
+
+  // Only what the plots and calculations use is kept
+  columnStoreSink store(findProbes(tokens, s));
+  std::unique_ptr<rawSink> stream;
+  resultSink* sink = &store;
+  if (outputFile != "") {
+    std::vector<std::string> names, types;
+    for (int row = 0; row < s.rows; row++) {
+      names.push_back(s[row][0].name);
+      types.push_back(symbolType(s[row][0].name));
+    }
+    stream = std::make_unique<rawSink>(outputFile, inputFile, names, types);
+    sink = stream.get();
+  }
+  auto run = [&](compiledDAE<function>& stepper) {
+    if (circuit.isAdaptive) {
+      stepper.solveAdaptive(initalValues, timeStep, stopTime, circuit.tolerance, circuit.maxStep, *sink);
+      std::cout << "Adaptive: " << stepper.acceptedSteps << " steps, " << stepper.rejectedSteps << " rejected" << std::endl;
+    } else {
+      stepper.solve(initalValues, timeStep, stopTime, *sink);
+    }
+    if (!circuit.devices.empty()) {
+      std::cout << "Newton: " << stepper.getNewton().iterations << " iterations, " << stepper.getNewton().factorizations << " factorizations" << std::endl;
+      if (stepper.newtonFailures > 0) {
+        std::cerr << "ERROR: Newton did not converge on " << stepper.newtonFailures << " steps" << std::endl;
+      }
+    }
+  };
+  if (circuit.useSparse) {
+    SparseDifferentialAlgebraicEquation<function> DAE = {circuit.sparseA, circuit.sparseE, f, s};
+    compiledDAE<function> stepper(DAE, circuit.method, circuit.devices);
+    run(stepper);
+  } else {
+    DifferentialAlgebraicEquation<double, double, function> DAE = {A, E, f, s};
+    compiledDAE<function> stepper(DAE, circuit.method, circuit.devices);
+    run(stepper);
+  }
+  if (stream) {
+    std::cout << "Wrote " << stream->points() << " points of " << s.rows << " unknowns to " << outputFile << std::endl;
+  } else {
+    postProcess("plotData.m", store.time, store.columns, s, tokens, writeRaw);
+  }
+
+  if (!circuit.sweeps.empty() || circuit.monteCarloRuns > 0) {
+    auto variants = createSweepVariants(circuit);
+    auto start = std::chrono::steady_clock::now();
+    auto sweep = runSweep(circuit, variants, findPlottedSymbols(tokens, s), threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Sweep: " << variants.size() << " runs in " << std::fixed << std::setprecision(3) << seconds << "s" << std::endl;
+    if (sweep.failedRuns > 0) {
+      std::cerr << "ERROR: " << sweep.failedRuns << " runs did not converge" << std::endl;
+    }
+    writeSweepData("sweepData.m", sweep, s);
+  }
   
   return 0;
 };
@@ -0,0 +1,110 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "BMaths/BMaths.h"
+
+// Everything the components write into A and E, in the order they wrote it.
+// An entry is either M(row, col) = coefficient or M(row, col) += coefficient * values[value],
+// where values holds the 1/R, C or L of each component (or 1 for the constant entries).
+// Once the circuit is built each entry is given its slot, where (row, col) is in
+// matrix::data or sparseMatrix::values. Stamping again after a value changes is then one
+// loop over the entries with no searching, no dynamic_cast and no walking the nodes.
+class stampList {
+public:
+  struct entry {
+    bool isE;
+    bool isSet; // = instead of +=
+    int row, col;
+    double coefficient;
+    int value;  // index into values, -1 for a constant
+    int slot = -1;
+  };
+
+  std::vector<entry> entries;
+  std::vector<double> values;
+
+  void add(bool isE, int row, int col, double coefficient, int value = -1) {
+    entries.push_back({isE, false, row, col, coefficient, value});
+  };
+  void set(bool isE, int row, int col, double coefficient) {
+    entries.push_back({isE, true, row, col, coefficient, -1});
+  };
+
+  // The location in values of a component, it is added the first time its name is seen
+  int addValue(const std::string& name, double value) {
+    auto it = valueLocations.find(name);
+    if (it != valueLocations.end()) {
+      return it->second;
+    }
+    values.push_back(value);
+    valueLocations.emplace(name, values.size() - 1);
+    return values.size() - 1;
+  };
+  // -1 if the component has no value
+  int findValue(const std::string& name) const {
+    auto it = valueLocations.find(name);
+    return (it == valueLocations.end()) ? -1 : it->second;
+  };
+
+  void clear() {
+    entries.clear();
+    values.clear();
+    valueLocations.clear();
+  };
+
+  // Adds every entry to the sparse pattern, A and E must be compressed afterwards
+  template<typename T1, typename T2>
+  void createPattern(sparseMatrix<T1>& A, sparseMatrix<T2>& E) const {
+    for (auto& e : entries) {
+      if (e.isE) {
+        E.at(e.row, e.col);
+      } else {
+        A.at(e.row, e.col);
+      }
+    }
+  };
+
+  template<typename M1, typename M2>
+  void findSlots(M1& A, M2& E) {
+    for (auto& e : entries) {
+      e.slot = e.isE ? &at(E, e.row, e.col) - storage(E) : &at(A, e.row, e.col) - storage(A);
+    }
+  };
+
+  // Sets A and E to what the entries give with these values, the pattern of A and E is kept
+  template<typename M1, typename M2>
+  void apply(M1& A, M2& E, const std::vector<double>& v) const {
+    auto a = storage(A);
+    auto e = storage(E);
+    std::fill(a, a + size(A), 0.0);
+    std::fill(e, e + size(E), 0.0);
+    for (auto& s : entries) {
+      auto& slot = s.isE ? e[s.slot] : a[s.slot];
+      if (s.isSet) {
+        slot = s.coefficient;
+      } else if (s.value == -1) {
+        slot += s.coefficient;
+      } else {
+        slot += s.coefficient * v[s.value];
+      }
+    }
+  };
+
+private:
+  std::unordered_map<std::string, int> valueLocations;
+
+  template<typename T>
+  static T& at(matrix<T>& M, int row, int col) { return M(row, col); };
+  template<typename T>
+  static T& at(sparseMatrix<T>& M, int row, int col) { return M.at(row, col); };
+  template<typename T>
+  static T* storage(matrix<T>& M) { return M.data.data(); };
+  template<typename T>
+  static T* storage(sparseMatrix<T>& M) { return M.values.data(); };
+  template<typename T>
+  static int size(const matrix<T>& M) { return M.data.size(); };
+  template<typename T>
+  static int size(const sparseMatrix<T>& M) { return M.values.size(); };
+};
@@ -0,0 +1,259 @@
+#include "sweep.h"
+#include "BMaths/threadPool.h"
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+
+using circuitType = Circuit<double, double, function>;
+
+// The netlist value of every resistor, capacitor and inductor, in the order they are first seen
+static std::vector<std::pair<std::shared_ptr<Component>, double>> findValueComponents(const circuitType& circuit) {
+  std::vector<std::pair<std::shared_ptr<Component>, double>> output;
+  for (auto node : circuit.nodes) {
+    for (auto& c : node->components) {
+      double value;
+      if (auto resistor = dynamic_cast<Resistor *>(c.first.get())) {
+        value = resistor->Resistance;
+      } else if (auto capacitor = dynamic_cast<Capacitor *>(c.first.get())) {
+        value = capacitor->Capacitance;
+      } else if (auto inductor = dynamic_cast<Inductor *>(c.first.get())) {
+        value = inductor->Inductance;
+      } else {
+        continue;
+      }
+      auto isSame = [&](auto& other) { return other.first->ComponentName == c.first->ComponentName; };
+      if (std::find_if(output.begin(), output.end(), isSame) == output.end()) {
+        output.push_back({c.first, value});
+      }
+    }
+  }
+  return output;
+}
+
+std::vector<sweepVariant> createSweepVariants(const circuitType& circuit) {
+  auto components = findValueComponents(circuit);
+  std::vector<sweepVariant> variants(1);
+  for (auto& sweep : circuit.sweeps) {
+    auto isSwept = [&](auto& c) { return c.first->ComponentName == sweep.componentName; };
+    if (std::find_if(components.begin(), components.end(), isSwept) == components.end()) {
+      std::cerr << "ERROR: Can only sweep a resistor, capacitor or inductor, `" << sweep.componentName << "` is not one." << std::endl;
+      continue;
+    }
+    std::vector<sweepVariant> output;
+    for (auto& variant : variants) {
+      for (int i = 0; i < sweep.points; i++) {
+        double value = sweep.start;
+        if (sweep.points > 1) {
+          value = sweep.start + (sweep.stop - sweep.start) * i / (sweep.points - 1);
+        }
+        sweepVariant v = variant;
+        v.values.push_back({sweep.componentName, value});
+        output.push_back(v);
+      }
+    }
+    variants = output;
+  }
+  if (circuit.monteCarloRuns <= 0) {
+    return variants;
+  }
+
+  std::mt19937 generator(circuit.monteCarloSeed);
+  std::uniform_real_distribution<double> distribution(-circuit.monteCarloTolerance, circuit.monteCarloTolerance);
+  std::vector<sweepVariant> output;
+  for (auto& variant : variants) {
+    for (int run = 0; run < circuit.monteCarloRuns; run++) {
+      sweepVariant v;
+      for (auto& c : components) {
+        double value = c.second;
+        for (auto& swept : variant.values) {
+          if (swept.first == c.first->ComponentName) {
+            value = swept.second;
+          }
+        }
+        v.values.push_back({c.first->ComponentName, value * (1.0 + distribution(generator))});
+      }
+      output.push_back(v);
+    }
+  }
+  return output;
+}
+
+std::vector<int> findPlottedSymbols(const std::vector<std::shared_ptr<token>>& tokens, const matrix<symbol>& syms) {
+  std::vector<int> output;
+  for (auto& t : tokens) {
+    if (t->type != token::PLOT) {
+      continue;
+    }
+    auto plotT = dynamic_cast<plotToken *>(t.get());
+    for (int row = 0; row < syms.rows; row++) {
+      if (syms[row][0].name == plotT->plotVaribleName) {
+        output.push_back(row);
+      }
+    }
+  }
+  return output;
+}
+
+// The stamped values of one run, the netlist values with the changed components swapped in
+static std::vector<double> variantValues(const circuitType& circuit, const std::unordered_map<std::string, Component::ComponentType>& types,
+                                         const sweepVariant& variant) {
+  std::vector<double> values = circuit.stamps.values;
+  for (auto& value : variant.values) {
+    int location = circuit.stamps.findValue(value.first);
+    auto type = types.find(value.first);
+    if (location != -1 && type != types.end()) {
+      values[location] = circuitType::stampedValue(type->second, value.second);
+    }
+  }
+  return values;
+}
+
+sweepResult runSweep(const circuitType& circuit, const std::vector<sweepVariant>& variants, const std::vector<int>& probes, int threads) {
+  std::unordered_map<std::string, Component::ComponentType> types;
+  for (auto& c : findValueComponents(circuit)) {
+    types.emplace(c.first->ComponentName, c.first->Type);
+  }
+  sweepResult result;
+  result.probes = probes;
+  result.variants = variants;
+  result.finalValues = std::vector<std::vector<double>>(variants.size());
+  std::vector<std::vector<double>> sum(probes.size());
+  std::mutex resultMutex;
+  int finishedRuns = 0;
+
+  auto runVariant = [&](int i) {
+    std::vector<std::shared_ptr<nonlinearDevice>> devices;
+    for (auto& device : circuit.devices) {
+      devices.push_back(device->clone());
+    }
+    bool failed = false;
+    std::vector<probe> kept;
+    for (int row : probes) {
+      kept.push_back({row});
+    }
+    columnStoreSink store(kept);
+    auto run = [&](auto& A, compiledDAE<function>& stepper) {
+      matrix<double> initalValues = circuit.initalValues;
+      if (circuit.seedFromOperatingPoint) {
+        failed = !DCOperatingPoint(A, circuit.f, circuit.nodes.size(), 0.0, initalValues, devices);
+      }
+      if (circuit.isAdaptive) {
+        stepper.solveAdaptive(initalValues, circuit.timeStep, circuit.stopTime, circuit.tolerance, circuit.maxStep, store);
+      } else {
+        stepper.solve(initalValues, circuit.timeStep, circuit.stopTime, store);
+      }
+      failed = failed || stepper.newtonFailures > 0 || stepper.isSingular;
+    };
+    if (circuit.useSparse) {
+      sparseMatrix<double> A = circuit.sparseA, E = circuit.sparseE;
+      circuit.stamps.apply(A, E, variantValues(circuit, types, variants[i]));
+      SparseDifferentialAlgebraicEquation<function> DAE = {A, E, circuit.f, circuit.syms};
+      compiledDAE<function> stepper(DAE, circuit.method, devices);
+      run(A, stepper);
+    } else {
+      matrix<double> A = circuit.A, E = circuit.E;
+      circuit.stamps.apply(A, E, variantValues(circuit, types, variants[i]));
+      DifferentialAlgebraicEquation<double, double, function> DAE = {A, E, circuit.f, circuit.syms};
+      compiledDAE<function> stepper(DAE, circuit.method, devices);
+      run(A, stepper);
+    }
+
+    auto output = store.take();
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (failed) {
+      result.failedRuns++;
+    }
+    if (finishedRuns == 0) {
+      result.time = output.first;
+      result.min = std::vector<std::vector<double>>(probes.size(), std::vector<double>(output.first.size(), INFINITY));
+      result.max = std::vector<std::vector<double>>(probes.size(), std::vector<double>(output.first.size(), -INFINITY));
+      for (auto& s : sum) {
+        s = std::vector<double>(output.first.size(), 0.0);
+      }
+    }
+    for (int p = 0; p < (int)probes.size(); p++) {
+      auto& data = output.second[probes[p]].data;
+      for (int k = 0; k < (int)data.size() && k < (int)sum[p].size(); k++) {
+        sum[p][k] += data[k];
+        result.min[p][k] = std::min(result.min[p][k], data[k]);
+        result.max[p][k] = std::max(result.max[p][k], data[k]);
+      }
+      result.finalValues[i].push_back(data.empty() ? 0.0 : data.back());
+    }
+    finishedRuns++;
+  };
+
+  threadPool pool(threads);
+  parallelFor(pool, variants.size(), runVariant);
+
+  result.mean = sum;
+  for (auto& m : result.mean) {
+    for (auto& value : m) {
+      value /= std::max(finishedRuns, 1);
+    }
+  }
+  return result;
+}
+
+void writeSweepData(const std::string& octaveFileName, const sweepResult& result, const matrix<symbol>& syms) {
+  std::ofstream file(octaveFileName);
+  if (!file.is_open()) {
+    std::cerr << "Error opening file" << std::endl;
+    return;
+  }
+  auto addVarible = [&](const std::string& name, const std::vector<double>& values) {
+    file << (name + " = [");
+    for (auto& value : values) {
+      file << std::scientific << std::setprecision(5) << value << " ";
+    }
+    file << ("];\n");
+  };
+  file << "set(0, 'DefaultTextFontSize', 25);";
+  file << "set(0, 'DefaultAxesFontSize', 25);";
+  addVarible("sweep_time", result.time);
+
+  // The value of each changed component in every run
+  std::vector<std::string> names;
+  for (auto& variant : result.variants) {
+    for (auto& value : variant.values) {
+      if (std::find(names.begin(), names.end(), value.first) == names.end()) {
+        names.push_back(value.first);
+      }
+    }
+  }
+  for (auto& name : names) {
+    std::vector<double> values;
+    for (auto& variant : result.variants) {
+      double v = NAN;
+      for (auto& value : variant.values) {
+        if (value.first == name) {
+          v = value.second;
+        }
+      }
+      values.push_back(v);
+    }
+    addVarible("sweep_" + name, values);
+  }
+
+  for (int p = 0; p < (int)result.probes.size(); p++) {
+    const std::string& name = syms[result.probes[p]][0].name;
+    std::vector<double> finalValues;
+    for (auto& f : result.finalValues) {
+      finalValues.push_back(p < (int)f.size() ? f[p] : NAN);
+    }
+    addVarible(name + "_mean", result.mean[p]);
+    addVarible(name + "_min", result.min[p]);
+    addVarible(name + "_max", result.max[p]);
+    addVarible(name + "_final", finalValues);
+    file << ("figure();\n");
+    file << ("plot(sweep_time, " + name + "_mean, sweep_time, " + name + "_min, \"--\", sweep_time, " + name + "_max, \"--\");\n");
+    file << ("xlabel(\"t\");\n");
+    file << ("ylabel(\"" + name + "\");\n");
+    file << ("legend(\"mean\", \"min\", \"max\");\n");
+  }
+  file.close();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include "circuit.h"
+#include "fileParser.h"
+
+// Parameter sweeps and Monte Carlo runs of one circuit.
+// The circuit is parsed and built once. Every variant makes its A and E from the
+// circuit's stamps with its own resistor, capacitor and inductor values, which is one
+// loop over the stamps, then the variants are run on a threadPool. Each run is folded into a running min, max and mean as soon as it
+// finishes so the memory does not grow with the number of runs.
+
+// The component values of one run that are different from the netlist
+struct sweepVariant {
+  std::vector<std::pair<std::string, double>> values;
+};
+
+struct sweepResult {
+  std::vector<double> time;
+  std::vector<int> probes; // rows of syms
+  // [probe][time] over every run
+  std::vector<std::vector<double>> mean, min, max;
+  std::vector<sweepVariant> variants;
+  // [variant][probe], the value at the end of each run
+  std::vector<std::vector<double>> finalValues;
+  int failedRuns = 0;
+};
+
+// Every combination of the sweep{} points, each run monte_carlo{} times with the
+// resistors, capacitors and inductors picked uniformly within the tolerance
+std::vector<sweepVariant> createSweepVariants(const Circuit<double, double, function>& circuit);
+// The rows of syms that are plotted
+std::vector<int> findPlottedSymbols(const std::vector<std::shared_ptr<token>>& tokens, const matrix<symbol>& syms);
+sweepResult runSweep(const Circuit<double, double, function>& circuit, const std::vector<sweepVariant>& variants, const std::vector<int>& probes, int threads = 0);
+void writeSweepData(const std::string& octaveFileName, const sweepResult& result, const matrix<symbol>& syms);
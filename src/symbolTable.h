@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "component.h"
+
+// Every unknown of the circuit by name, with its row in syms.
+// Each name is stored once and looked up through a hash map, and the nodes can
+// also be looked up by pointer, so finding where a component stamps is O(1)
+// instead of a string compare against every symbol.
+class symbolTable {
+public:
+  // Returns the location of name, adding it to the end if it is new
+  int add(const std::string& name) {
+    auto it = locations.find(name);
+    if (it != locations.end()) {
+      return it->second;
+    }
+    int location = names.size();
+    names.push_back(name);
+    locations.emplace(name, location);
+    return location;
+  };
+  // Every node is a row, even if its name is already in the table
+  int addNode(Node* node) {
+    int location = names.size();
+    names.push_back(node->nodeName);
+    locations.emplace(node->nodeName, location);
+    nodeLocations.emplace(node, location);
+    return location;
+  };
+
+  // -1 if it is not in the table
+  int find(const std::string& name) const {
+    auto it = locations.find(name);
+    return (it == locations.end()) ? -1 : it->second;
+  };
+  int find(Node* node) const {
+    auto it = nodeLocations.find(node);
+    return (it == nodeLocations.end()) ? find(node->nodeName) : it->second;
+  };
+  bool contains(const std::string& name) const { return locations.count(name) != 0; };
+
+  const std::string& name(int location) const { return names[location]; };
+  int size() const { return names.size(); };
+  void clear() {
+    names.clear();
+    locations.clear();
+    nodeLocations.clear();
+  };
+
+private:
+  std::vector<std::string> names;
+  std::unordered_map<std::string, int> locations;
+  std::unordered_map<Node*, int> nodeLocations;
+};
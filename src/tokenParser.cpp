@@ -2,11 +2,79 @@
 #include "circuit.h"
 #include "fileParser.h"
 #include <memory>
+#include <numeric>
+#include <unordered_map>
+
+std::vector<probe> findProbes(std::vector<std::shared_ptr<token>>& tokens, const matrix<symbol>& syms) {
+  std::unordered_map<std::string, int> rows;
+  for (int row = 0; row < syms.rows; row++) {
+    rows.emplace(syms[row][0].name, row);
+  }
+  std::unordered_map<std::string, std::vector<std::string>> componentNodes;
+  for (auto& t : tokens) {
+    if (t->type == token::NODE) {
+      auto nodeT = dynamic_cast<nodeToken *>(t.get());
+      for (auto& component : nodeT->components) {
+        componentNodes[dynamic_cast<componentToken *>(component.first.get())->name].push_back(nodeT->name);
+      }
+    }
+  }
+
+  // 0 if the row is not needed
+  std::vector<int> decimation(syms.rows, 0);
+  auto need = [&](const std::string& name, int every) {
+    auto it = rows.find(name);
+    if (it != rows.end()) {
+      int& d = decimation[it->second];
+      d = (d == 0) ? every : std::gcd(d, every);
+    }
+  };
+  for (auto& t : tokens) {
+    if (t->type == token::PLOT) {
+      auto plotT = dynamic_cast<plotToken *>(t.get());
+      need(plotT->plotVaribleName, plotT->decimation);
+    } else if (t->type == token::FOURIER) {
+      auto fourierT = dynamic_cast<fourierToken *>(t.get());
+      need(dynamic_cast<dataToken *>(fourierT->inputDataToken.get())->name, 1);
+    } else if (t->type == token::CALCULATE) {
+      // Calculated data can be used by later calculations, so everything they use is kept whether it is plotted or not
+      auto calcT = dynamic_cast<calculateToken *>(t.get());
+      for (auto& arg : calcT->args) {
+        if (auto componentT = dynamic_cast<componentToken *>(arg.get())) {
+          for (auto& node : componentNodes[componentT->name]) {
+            need(node, 1);
+          }
+          need("i_" + componentT->name, 1);
+        } else if (auto dataT = dynamic_cast<dataToken *>(arg.get())) {
+          need(dataT->name, 1);
+        }
+      }
+    }
+  }
+
+  std::vector<probe> output;
+  for (int row = 0; row < syms.rows; row++) {
+    if (decimation[row] != 0) {
+      output.push_back({row, decimation[row]});
+    }
+  }
+  for (auto& t : tokens) {
+    if (t->type == token::PLOT) {
+      auto plotT = dynamic_cast<plotToken *>(t.get());
+      auto it = rows.find(plotT->plotVaribleName);
+      if (it != rows.end() && plotT->dataToken) {
+        dynamic_cast<dataToken *>(plotT->dataToken.get())->decimation = decimation[it->second];
+      }
+    }
+  }
+  return output;
+}
 
 // data is in a weird format
 // it is a vector of matrix that is similar to syms
-postProcess::postProcess(const std::string& octaveFileName, std::vector<double> &time, std::vector<matrix<double>> &data, matrix<symbol> &syms, std::vector<std::shared_ptr<token>> &tokens)
-  : fileName(octaveFileName), time(time), data(data), syms(syms), tokens(tokens) {
+postProcess::postProcess(const std::string& octaveFileName, std::vector<double> &time, std::vector<matrix<double>> &data, matrix<symbol> &syms, std::vector<std::shared_ptr<token>> &tokens, bool binary)
+  : fileName(octaveFileName), time(time), data(data), syms(syms), tokens(tokens), binary(binary) {
+  rawFileName = fileName.substr(0, fileName.rfind(".m")) + ".raw";
 
   file.open(fileName);
 
@@ -15,8 +83,14 @@ postProcess::postProcess(const std::string& octaveFileName, std::vector<double>
     return;
   }
   fillInDataTokens();
+  if (binary) {
+    addRawLoader();
+  }
   createOctavePlotFileFromTokens();
   file.close();
+  if (binary) {
+    writeRawFile();
+  }
 };
 
 postProcess::~postProcess() {
@@ -30,7 +104,7 @@ void postProcess::fillInDataTokens() {
       auto d = dynamic_cast<dataToken *>(t->voltageDataToken.get());
       int idx = findIdxFromName(d->name);
       if (idx >= 0) {
-        d->data = {data[idx].data[0]};
+        d->data = {data[idx].data};
       }
       
       break;
@@ -40,13 +114,13 @@ void postProcess::fillInDataTokens() {
       auto d1 = dynamic_cast<dataToken *>(t->voltageDataToken.get());
       int idx1 = findIdxFromName(d1->name);
       if (idx1 >= 0) {
-        d1->data = {data[idx1].data[0]};
+        d1->data = {data[idx1].data};
       }
 
       auto d2 = dynamic_cast<dataToken *>(t->currentDataToken.get());
       int idx2 = findIdxFromName(d2->name);
       if (idx2 >= 0) {
-        d2->data = {data[idx2].data[0]};
+        d2->data = {data[idx2].data};
       }
 
       break;
@@ -56,13 +130,18 @@ void postProcess::fillInDataTokens() {
       auto d = dynamic_cast<dataToken *>(t->dataToken.get());
       int idx = findIdxFromName(d->name);
       if (idx >= 0) {
-        d->data = {data[idx].data[0]};
+        d->data = {data[idx].data};
       }
       break;
     }
     case token::CALCULATE:
     case token::FOURIER:
     case token::TIME:
+    case token::ADAPTIVE:
+    case token::OPERATING_POINT:
+    case token::AC_SWEEP:
+    case token::SWEEP:
+    case token::MONTE_CARLO:
     case token::DATA: {
       break;
     }
@@ -73,7 +152,7 @@ void postProcess::fillInDataTokens() {
 int postProcess::findIdxFromName(std::string name) {
   for (int row = 0; row < syms.rows; row++) {
     for (int col = 0; col < syms.cols; col++) {
-      if (syms.data[row][col].name == name) {
+      if (syms[row][col].name == name) {
         return row;
       }
     }
@@ -82,7 +161,116 @@ int postProcess::findIdxFromName(std::string name) {
   return -1;
 }
   
-void postProcess::addOctaveVarible(const std::string &name, std::vector<double> plotData) {
+std::string symbolType(const std::string& name) {
+  return (name.rfind("i_", 0) == 0) ? "current" : "voltage";
+}
+
+std::string postProcess::typeOf(const std::string &name) {
+  if (findIdxFromName(name) >= 0) {
+    return symbolType(name);
+  }
+  for (auto& t : tokens) {
+    if (t->type != token::CALCULATE) {
+      continue;
+    }
+    auto calcT = dynamic_cast<calculateToken *>(t.get());
+    if (dynamic_cast<dataToken *>(calcT->output.get())->name != name) {
+      continue;
+    }
+    switch (calcT->calculationType) {
+    case calculateToken::VOLTAGE:
+      return "voltage";
+    case calculateToken::CURRENT:
+      return "current";
+    default: { // Adding or subtracting keeps the type
+      auto arg = dynamic_cast<dataToken *>(calcT->args[0].get());
+      return arg ? typeOf(arg->name) : "notype";
+    }
+    }
+  }
+  return "notype";
+}
+
+// Octave functions can only be in a script that does not start with one, hence the 1;
+void postProcess::addRawLoader() {
+  file << "1;\n";
+  file << "% raw{k}.NAME is the vector NAME of the k-th plot of a SPICE binary raw file\n";
+  file << "function raw = loadRaw(fileName)\n";
+  file << "  raw = {};\n";
+  file << "  names = {};\n";
+  file << "  f = fopen(fileName, \"rb\");\n";
+  file << "  while true\n";
+  file << "    line = fgetl(f);\n";
+  file << "    if !ischar(line)\n";
+  file << "      break;\n";
+  file << "    end\n";
+  file << "    if strncmp(line, \"No. Variables:\", 14)\n";
+  file << "      n = str2double(line(15:end));\n";
+  file << "    elseif strncmp(line, \"No. Points:\", 11)\n";
+  file << "      points = str2double(line(12:end));\n";
+  file << "    elseif strncmp(line, \"Variables:\", 10)\n";
+  file << "      for k = 1:n\n";
+  file << "        fields = strsplit(strtrim(fgetl(f)), \"\\t\");\n";
+  file << "        names{k} = fields{2};\n";
+  file << "      end\n";
+  file << "    elseif strncmp(line, \"Binary:\", 7)\n";
+  file << "      data = fread(f, [n, points], \"double\", 0, \"ieee-le\");\n";
+  file << "      vectors = struct();\n";
+  file << "      for k = 1:n\n";
+  file << "        vectors.(names{k}) = data(k, :);\n";
+  file << "      end\n";
+  file << "      raw{end + 1} = vectors;\n";
+  file << "    end\n";
+  file << "  end\n";
+  file << "  fclose(f);\n";
+  file << "end\n";
+  std::string baseName = rawFileName.substr(rawFileName.find_last_of("/\\") + 1);
+  file << "raw = loadRaw(\"" << baseName << "\");\n";
+}
+
+void postProcess::writeRawFile() {
+  std::ofstream raw(rawFileName, std::ios::binary);
+  if (!raw.is_open()) {
+    std::cerr << "ERROR: Unable to open `" << rawFileName << "` for writing" << std::endl;
+    return;
+  }
+  std::vector<double> point;
+  for (auto& plot : rawPlots) {
+    int points = plot.vectors[0].size();
+    writeRawHeader(raw, fileName, plot.name, plot.names, plot.types, points);
+    point.resize(plot.vectors.size());
+    for (int k = 0; k < points; k++) {
+      for (int v = 0; v < (int)plot.vectors.size(); v++) {
+        point[v] = (k < (int)plot.vectors[v].size()) ? plot.vectors[v][k] : 0.0;
+      }
+      raw.write(reinterpret_cast<const char*>(point.data()), point.size() * sizeof(double));
+    }
+  }
+}
+
+void postProcess::addOctaveVarible(const std::string &name, const std::vector<double>& plotData, const std::string &scale) {
+  if (binary) {
+    // The first vector given for a scale is the scale itself
+    auto it = rawPlotLocations.find(scale);
+    if (it == rawPlotLocations.end()) {
+      bool isTime = (scale == "t" || scale.rfind("t_", 0) == 0);
+      rawPlots.push_back({isTime ? "Transient Analysis" : "Spectrum", {}, {}, {}});
+      it = rawPlotLocations.emplace(scale, rawPlots.size() - 1).first;
+    }
+    auto& plot = rawPlots[it->second];
+    if (plot.names.empty()) {
+      plot.types.push_back(name.rfind("frequency_", 0) == 0 ? "frequency" : "time");
+    } else {
+      if (plotData.size() != plot.vectors[0].size()) {
+        std::cerr << "ERROR: `" << name << "` has " << plotData.size() << " points but `" << scale << "` has " << plot.vectors[0].size() << std::endl;
+      }
+      plot.types.push_back(typeOf(name));
+    }
+    plot.names.push_back(name);
+    plot.vectors.push_back(plotData);
+    file << name << " = raw{" << it->second + 1 << "}." << name << ";\n";
+    return;
+  }
   file << (name + " = [");
   //std::cout << plotData.size() << std::endl;
   for (int i = 0; i < plotData.size(); i++) {
@@ -91,21 +279,45 @@ void postProcess::addOctaveVarible(const std::string &name, std::vector<double>
   file << ("];\n");
 };
 
-void postProcess::addPlot(const std::string &name, std::vector<double> plotData) {
+void postProcess::addPlot(const std::string &name, const std::vector<double>& plotData, int decimation, int every) {
   //std::cout << name << " " << plotData.size() << std::endl;
-  addOctaveVarible(name, plotData);
+  // In the raw file decimated vectors need a time vector of their own
+  std::string scale = "t";
+  if (decimation > 1) {
+    scale = "t_" + std::to_string(decimation);
+    if (binary && rawPlotLocations.count(scale) == 0) {
+      std::vector<double> scaleData;
+      for (int i = 0; i < (int)time.size(); i += decimation) {
+        scaleData.push_back(time[i]);
+      }
+      addOctaveVarible(scale, scaleData, scale);
+    }
+  }
+  if (every > 1) {
+    std::vector<double> kept;
+    for (int i = 0; i < (int)plotData.size(); i += every) {
+      kept.push_back(plotData[i]);
+    }
+    addOctaveVarible(name, kept, scale);
+  } else {
+    addOctaveVarible(name, plotData, scale);
+  }
   file << ("figure();\n");
-  file << ("plot(t, " + name + ");\n");
+  if (decimation > 1) {
+    file << ("plot(t(1:" + std::to_string(decimation) + ":end), " + name + ");\n");
+  } else {
+    file << ("plot(t, " + name + ");\n");
+  }
   file << ("xlabel(\"t\");\n");
   file << ("ylabel(\"" + name + "\");\n");
 };
 
-void postProcess::addFourierPlot(const std::string &name, std::vector<double> frequencyData, std::vector<double> magnitudeData) {// TODO: Deal with phase
+void postProcess::addFourierPlot(const std::string &name, const std::vector<double>& frequencyData, const std::vector<double>& magnitudeData) {// TODO: Deal with phase
   const std::string fName = "frequency_" + name;
   const std::string mName = "magnitude_" + name;
   const std::string pName = "phase_" + name;
-  addOctaveVarible(fName, frequencyData);
-  addOctaveVarible(mName, magnitudeData);  
+  addOctaveVarible(fName, frequencyData, fName);
+  addOctaveVarible(mName, magnitudeData, fName);
   file << ("figure();\n");
   file << ("plot(" + fName + "," + mName + ");\n");
   file << ("xlabel(\"" + fName + "\");\n");
@@ -127,8 +339,10 @@ void postProcess::createOctavePlotFileFromTokens() {
       //for (auto i : dataT->data[0]) {
       //  std::cout << i << " ";
       //}
-      addPlot(plotT->plotVaribleName, dataT->data[0]);
-      if (dataT->data[0].size() == time.size()) {
+      // The data may already be decimated, if it is the plot's decimation is a multiple of the data's
+      int stored = dataT->decimation;
+      addPlot(plotT->plotVaribleName, dataT->data[0], plotT->decimation, plotT->decimation / stored);
+      if (dataT->data[0].size() == (time.size() + stored - 1) / stored) {
         isValidPlot = true;
       }
       if (!isValidPlot) {
@@ -142,10 +356,10 @@ void postProcess::createOctavePlotFileFromTokens() {
       auto outputDataT = dynamic_cast<dataToken *>(fourierT->outputDataToken.get());      
       matrix<double> toTransform = {{inputDataT->data}, (int)inputDataT->data[0].size(), 1};
       FourierTransform dft(time, toTransform);
-      addFourierPlot(outputDataT->name, dft.frequency.data[0], dft.magnitudes.data[0]);
-      outputDataT->addData(dft.frequency.data[0]);
-      outputDataT->addData(dft.magnitudes.data[0]);
-      outputDataT->addData(dft.phases.data[0]);
+      addFourierPlot(outputDataT->name, dft.frequency.data, dft.magnitudes.data);
+      outputDataT->addData(dft.frequency.data);
+      outputDataT->addData(dft.magnitudes.data);
+      outputDataT->addData(dft.phases.data);
       isValidPlot = true;
 
       if (!isValidPlot) {
@@ -235,8 +449,15 @@ std::vector<double> postProcess::calculateCurrent(std::shared_ptr<token> t) {
     return output;
     break;
   }
-  case Component::DIODE: {
-    std::cerr << "TODO: Diodes not done yet" << std::endl;
+  case Component::DIODE: { // use the diode model, I = Is (e^(V/Vt) - 1)
+    auto voltage = calculateVoltage(t);
+    auto diode = dynamic_cast<Diode *>(componentT->circuitComponentPtr.get());
+    diodeDevice model(-1, -1, diode->saturationCurrent());
+    std::vector<double> output(voltage.size(), 0.0);
+    for (int i = 0; i < voltage.size(); i++) {
+      output[i] = model.current(voltage[i]);
+    }
+    return output;
     break;
   }
   default: {
@@ -319,8 +540,30 @@ std::vector<double> postProcess::calculateVoltage(std::shared_ptr<token> t) {
     return output;
     break;
   }
-  case Component::DIODE: {
-    std::cerr << "TODO: Diodes not done yet" << std::endl;
+  case Component::DIODE: { // use V = node+ - node-
+    std::vector<double> vP, vN;
+    for (auto& connectedNode : getConnectedNodesFromComponentPtr(t)) {
+      auto nodeT = dynamic_cast<nodeToken *>(connectedNode.get());
+      for (auto& c : nodeT->components) {
+        auto cToken = dynamic_cast<componentToken *>(c.first.get());
+        if (cToken->name != componentT->name) {
+          continue;
+        }
+        if (c.second == Component::DIODE_P) {
+          vP = getDataFromToken(connectedNode);
+        } else if (c.second == Component::DIODE_N) {
+          vN = getDataFromToken(connectedNode);
+        }
+      }
+    }
+    if (vP.size() != vN.size()) {
+      std::cerr << "ERROR: For some reason voltages have different sizes?" << std::endl;
+    }
+    std::vector<double> output(std::min(vP.size(), vN.size()), 0.0);
+    for (int i = 0; i < output.size(); i++) {
+      output[i] = vP[i] - vN[i];
+    }
+    return output;
     break;
   }
   default: {
@@ -355,8 +598,8 @@ std::vector<double> postProcess::getDataFromToken(std::shared_ptr<token> t) {
     auto T = dynamic_cast<componentToken *>(t.get());
     for (int row = 0; row < syms.rows; row++) {
       for (int col = 0; col < syms.cols; col++) {
-        if (syms.data[row][col].name == "i_" + T->name) {
-          return data[row].data[0];
+        if (syms[row][col].name == "i_" + T->name) {
+          return data[row].data;
         }
       }
     }
@@ -366,8 +609,8 @@ std::vector<double> postProcess::getDataFromToken(std::shared_ptr<token> t) {
     auto T = dynamic_cast<nodeToken *>(t.get());
     for (int row = 0; row < syms.rows; row++) {
       for (int col = 0; col < syms.cols; col++) {
-        if (syms.data[row][col].name == T->name) {
-          return data[row].data[0];
+        if (syms[row][col].name == T->name) {
+          return data[row].data;
         }
       }
     }
@@ -383,3 +626,54 @@ std::vector<double> postProcess::getDataFromToken(std::shared_ptr<token> t) {
 
 
 
+
+void writeACData(const std::string& octaveFileName, const ACResult& result, matrix<symbol>& syms, std::vector<std::shared_ptr<token>>& tokens) {
+  std::ofstream file(octaveFileName);
+  if (!file.is_open()) {
+    std::cerr << "Error opening file" << std::endl;
+    return;
+  }
+  auto addVarible = [&](const std::string& name, const std::vector<double>& values) {
+    file << (name + " = [");
+    for (auto& value : values) {
+      file << std::scientific << std::setprecision(5) << value << " ";
+    }
+    file << ("];\n");
+  };
+  file << "set(0, 'DefaultTextFontSize', 25);";
+  file << "set(0, 'DefaultAxesFontSize', 25);";
+  addVarible("f_ac", result.frequency);
+
+  for (auto& t : tokens) {
+    if (t->type != token::PLOT) {
+      continue;
+    }
+    auto plotT = dynamic_cast<plotToken *>(t.get());
+    const std::string& name = plotT->plotVaribleName;
+    int idx = -1;
+    for (int row = 0; row < syms.rows; row++) {
+      if (syms[row][0].name == name) {
+        idx = row;
+      }
+    }
+    if (idx < 0) {
+      continue;
+    }
+    std::vector<double> magnitude, phase;
+    for (auto& x : result.solution) {
+      magnitude.push_back(20 * std::log10(std::max(x[idx].magnitude(), 1e-300)));
+      phase.push_back(x[idx].phase() * 180 / M_PI);
+    }
+    addVarible("magnitude_ac_" + name, magnitude);
+    addVarible("phase_ac_" + name, phase);
+    file << ("figure();\n");
+    file << ("subplot(2, 1, 1);\n");
+    file << ("semilogx(f_ac, magnitude_ac_" + name + ");\n");
+    file << ("ylabel(\"|" + name + "| (dB)\");\n");
+    file << ("subplot(2, 1, 2);\n");
+    file << ("semilogx(f_ac, phase_ac_" + name + ");\n");
+    file << ("xlabel(\"f\");\n");
+    file << ("ylabel(\"phase " + name + " (deg)\");\n");
+  }
+  file.close();
+}
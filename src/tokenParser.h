@@ -2,31 +2,63 @@
 #include "circuit.h"
 #include "BMaths/fourierTransform.h"
 #include "fileParser.h"
+#include "BMaths/resultSink.h"
 #include <memory>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <unordered_map>
 
 template<typename T1, typename T2, typename T3>
 Circuit<T1, T2, T3> createCircuitFromTokens(std::vector<std::shared_ptr<token>>& tokens);
 
 
+// The rows of syms that the plot, fourier_transform and calculate tokens need, so only those are stored.
+// A row that is only plotted is kept every gcd of its plots' decimations, anything else needs every point.
+// The decimation of each plotted data token is set to match
+std::vector<probe> findProbes(std::vector<std::shared_ptr<token>>& tokens, const matrix<symbol>& syms);
+
+// The SPICE raw type of an unknown, currents are named i_ and everything else is a node voltage
+std::string symbolType(const std::string& name);
+
+// Writes the magnitude (dB) and phase (degrees) of every plotted unknown as an octave file
+void writeACData(const std::string& octaveFileName, const ACResult& result, matrix<symbol>& syms, std::vector<std::shared_ptr<token>>& tokens);
+
 class postProcess {
 public:
-  postProcess(const std::string& octaveFileName, std::vector<double> &time, std::vector<matrix<double>> &data, matrix<symbol> &syms, std::vector<std::shared_ptr<token>> &tokens);
+  // With binary the vectors go to a SPICE raw file next to the octave file (.raw instead of .m),
+  // and the octave file only loads them and plots
+  postProcess(const std::string& octaveFileName, std::vector<double> &time, std::vector<matrix<double>> &data, matrix<symbol> &syms, std::vector<std::shared_ptr<token>> &tokens, bool binary = false);
   ~postProcess();
   
 private:
   const std::string fileName;
-  std::vector<double> time;
-  std::vector<matrix<double>> data;
+  // Not copied, the results only have to outlive the postProcess
+  const std::vector<double>& time;
+  const std::vector<matrix<double>>& data;
   matrix<symbol> syms;
   std::vector<std::shared_ptr<token>> tokens;
   std::ofstream file;
+
+  // The plots of the raw file, one for each scale
+  struct rawPlot {
+    std::string name;
+    std::vector<std::string> names, types;
+    std::vector<std::vector<double>> vectors;
+  };
+  bool binary;
+  std::string rawFileName;
+  std::vector<rawPlot> rawPlots;
+  std::unordered_map<std::string, int> rawPlotLocations;
+  void writeRawFile();
+  void addRawLoader();
+  std::string typeOf(const std::string &name);
   
-  void addOctaveVarible(const std::string &name, std::vector<double> plotData);
-  void addPlot(const std::string &name, std::vector<double> plotData);
-  void addFourierPlot(const std::string &name, std::vector<double> frequencyData, std::vector<double> magnitudeData);
+  // scale is the name of the time or frequency vector that plotData goes with
+  void addOctaveVarible(const std::string &name, const std::vector<double>& plotData, const std::string &scale = "t");
+  // Plots every every-th point of plotData against every decimation-th point of t
+  void addPlot(const std::string &name, const std::vector<double>& plotData, int decimation = 1, int every = 1);
+  void addFourierPlot(const std::string &name, const std::vector<double>& frequencyData, const std::vector<double>& magnitudeData);
 
   void createOctavePlotFileFromTokens();
 
@@ -53,6 +85,35 @@ Circuit<T1, T2, T3> createCircuitFromTokens(std::vector<std::shared_ptr<token>>&
       circuit.stopTime = stopTime->data[0][0];
       auto timeStep = dynamic_cast<dataToken *>(time->timeStep.get());
       circuit.timeStep = timeStep->data[0][0];
+      getIntegrationMethod(time->method, circuit.method);
+    }
+    if (token->type == token::ADAPTIVE) {
+      auto adaptive = dynamic_cast<adaptiveToken *>(token.get());
+      circuit.isAdaptive = true;
+      circuit.tolerance = adaptive->tolerance;
+      circuit.maxStep = adaptive->maxStep;
+    }
+    if (token->type == token::OPERATING_POINT) {
+      auto operatingPoint = dynamic_cast<operatingPointToken *>(token.get());
+      circuit.findOperatingPoint = true;
+      circuit.seedFromOperatingPoint = operatingPoint->seedTransient;
+    }
+    if (token->type == token::AC_SWEEP) {
+      auto ac = dynamic_cast<acToken *>(token.get());
+      circuit.runACSweep = true;
+      circuit.acStart = ac->start;
+      circuit.acStop = ac->stop;
+      circuit.acPoints = ac->points;
+    }
+    if (token->type == token::SWEEP) {
+      auto sweep = dynamic_cast<sweepToken *>(token.get());
+      circuit.sweeps.push_back({sweep->componentName, sweep->start, sweep->stop, sweep->points});
+    }
+    if (token->type == token::MONTE_CARLO) {
+      auto monteCarlo = dynamic_cast<monteCarloToken *>(token.get());
+      circuit.monteCarloRuns = monteCarlo->runs;
+      circuit.monteCarloTolerance = monteCarlo->tolerance;
+      circuit.monteCarloSeed = monteCarlo->seed;
     }
     if (token->type == token::NODE) {
       auto nodeT = dynamic_cast<nodeToken *>(token.get());